@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bvh.h"
+#include "parallel.h"
+
+/*
+Builds the bvh of a field of tessellated spheres on one core and on all the
+cores and reports the build times, the nodes and the depth of the tree, then
+casts random rays through the field and reports the rays per second on one
+core and on all the cores. A sample of the rays is checked against testing
+every triangle.
+
+usage: bench_bvh [number of spheres, 1024 by default]
+*/
+
+void generate_spheres(int count, int rings, int segments, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices) {
+	const float pi = 3.14159265358979f;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> size(0.2f, 2.0f);
+	for (int sphere = 0; sphere < count; sphere++) {
+		glm::vec3 center(coordinate(random), coordinate(random) * 0.2f, coordinate(random));
+		float radius = size(random);
+		uint32_t first = positions.size();
+		for (int r = 0; r <= rings; r++) {
+			float theta = pi * r / rings;
+			for (int s = 0; s <= segments; s++) {
+				float phi = 2.0f * pi * s / segments;
+				glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+				positions.push_back(center + normal * radius);
+			}
+		}
+		for (int r = 0; r < rings; r++) {
+			for (int s = 0; s < segments; s++) {
+				uint32_t a = first + r * (segments + 1) + s;
+				uint32_t b = a + segments + 1;
+				indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+			}
+		}
+	}
+}
+
+template <typename Run>
+double best_seconds(int num_runs, Run run) {
+	double seconds = 1e30;
+	for (int i = 0; i < num_runs; i++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		run();
+		auto end = std::chrono::high_resolution_clock::now();
+		seconds = std::min(seconds, std::chrono::duration<double>(end - start).count());
+	}
+	return seconds;
+}
+
+void report_tree(const Bvh& bvh) {
+	uint32_t leaves = 0;
+	uint32_t max_depth = 0;
+	std::vector<uint32_t> depth(bvh.nodes.size(), 0);
+	for (size_t i = 0; i < bvh.nodes.size(); i++) {
+		max_depth = std::max(max_depth, depth[i]);
+		if (bvh.nodes[i].count > 0) {
+			leaves++;
+			continue;
+		}
+		depth[bvh.nodes[i].first] = depth[i] + 1;
+		depth[bvh.nodes[i].first + 1] = depth[i] + 1;
+	}
+	std::cout << "  " << bvh.nodes.size() << " nodes, " << leaves << " leaves of "
+		<< double(bvh.indices.size()) / std::max(leaves, 1u) << " triangles on average, depth " << max_depth << std::endl;
+}
+
+int main(int argc, char** argv) {
+	int num_spheres = argc > 1 ? std::stoi(argv[1]) : 1024;
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	generate_spheres(num_spheres, 16, 32, positions, indices);
+	TriangleMesh mesh = { reinterpret_cast<const char*>(positions.data()), sizeof(glm::vec3), indices.data(),
+		static_cast<uint32_t>(indices.size() / 3) };
+	std::cout << num_spheres << " spheres, " << mesh.triangle_count << " triangles" << std::endl;
+
+	// build
+	std::vector<BvhBox> boxes = triangle_boxes(mesh);
+	Bvh bvh;
+	double serial_seconds = best_seconds(3, [&]() { bvh = build_bvh(boxes, false); });
+	std::cout << "build on 1 core: " << serial_seconds * 1000.0 << " ms" << std::endl;
+	report_tree(bvh);
+	double parallel_seconds = best_seconds(3, [&]() { bvh = build_bvh(boxes, true); });
+	std::cout << "build on " << get_num_workers() << " cores: " << parallel_seconds * 1000.0 << " ms, "
+		<< serial_seconds / parallel_seconds << "x" << std::endl;
+	report_tree(bvh);
+	if (!valid_bvh(bvh, mesh.triangle_count)) std::cout << "the bvh is not valid" << std::endl;
+
+	// random rays from inside the field
+	const int num_rays = 1 << 20;
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+	std::normal_distribution<float> axis;
+	std::vector<Ray> rays;
+	rays.reserve(num_rays);
+	for (int i = 0; i < num_rays; i++) {
+		glm::vec3 direction(axis(random), axis(random), axis(random));
+		rays.push_back(Ray(glm::vec3(coordinate(random), coordinate(random) * 0.2f, coordinate(random)),
+			glm::normalize(direction)));
+	}
+
+	// traverse
+	std::vector<float> distances(num_rays);
+	auto cast = [&](int first, int last) {
+		for (int i = first; i < last; i++) {
+			float t = 1000.0f;
+			uint32_t triangle;
+			distances[i] = intersect_triangles(bvh, mesh, rays[i], t, triangle) ? t : -1.0f;
+		}
+	};
+	double one_core = best_seconds(3, [&]() { cast(0, num_rays); });
+	const int num_pieces = 256;
+	double all_cores = best_seconds(3, [&]() {
+		parallel_for(num_pieces, [&](int piece) {
+			cast(num_rays / num_pieces * piece, num_rays / num_pieces * (piece + 1));
+		});
+	});
+	int num_hits = std::count_if(distances.begin(), distances.end(), [](float t) { return t >= 0.0f; });
+	std::cout << num_rays << " rays, " << num_hits << " hit" << std::endl;
+	std::cout << "traverse on 1 core: " << num_rays / one_core / 1e6 << " Mrays/s" << std::endl;
+	std::cout << "traverse on " << get_num_workers() << " cores: " << num_rays / all_cores / 1e6 << " Mrays/s" << std::endl;
+
+	// check a sample against every triangle
+	int num_wrong = 0;
+	for (int i = 0; i < num_rays; i += num_rays / 256) {
+		float nearest = 1000.0f;
+		bool hit = false;
+		for (uint32_t triangle = 0; triangle < mesh.triangle_count; triangle++) {
+			const uint32_t* corners = mesh.indices + 3 * triangle;
+			float t;
+			if (intersect_triangle(rays[i], mesh.position(corners[0]), mesh.position(corners[1]), mesh.position(corners[2]),
+				nearest, t)) {
+				nearest = t;
+				hit = true;
+			}
+		}
+		if ((distances[i] >= 0.0f) != hit || (hit && std::fabs(distances[i] - nearest) > 1e-4f)) num_wrong++;
+	}
+	std::cout << num_wrong << " of 256 sampled rays differ from testing every triangle" << std::endl;
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "geometry_codec.h"
+#include "parallel.h"
+
+/*
+Encodes and decodes the geometry streams of a tessellated sphere with the
+geometry codec and reports the compression ratio, the decode throughput and
+the largest error of the positions and the normals.
+
+usage: bench_geometry_codec [number of rings, 1000 by default]
+*/
+
+void generate_sphere(int rings, int segments, std::vector<VertexWithTangent>& vertices, std::vector<uint32_t>& indices) {
+	const float pi = 3.14159265358979f;
+	for (int r = 0; r <= rings; r++) {
+		float theta = pi * r / rings;
+		for (int s = 0; s <= segments; s++) {
+			float phi = 2.0f * pi * s / segments;
+			glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			VertexWithTangent vertex(normal * 12.5f, normal, glm::vec2(float(s) / segments, float(r) / rings));
+			vertex.tangent = glm::vec3(-std::sin(phi), 0.0f, std::cos(phi));
+			vertices.push_back(vertex);
+		}
+	}
+	for (int r = 0; r < rings; r++) {
+		for (int s = 0; s < segments; s++) {
+			uint32_t a = r * (segments + 1) + s;
+			uint32_t b = a + segments + 1;
+			indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+		}
+	}
+}
+
+template <typename Decode>
+double best_seconds(int num_runs, Decode decode) {
+	double seconds = 1e30;
+	for (int run = 0; run < num_runs; run++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		decode();
+		auto end = std::chrono::high_resolution_clock::now();
+		seconds = std::min(seconds, std::chrono::duration<double>(end - start).count());
+	}
+	return seconds;
+}
+
+template <typename VertexType>
+void report_vertex_error(std::string name, const std::vector<VertexType>& original, const std::vector<VertexType>& decoded) {
+	float position_error = 0.0f;
+	float normal_error = 0.0f;
+	bool uv_exact = true;
+	for (size_t i = 0; i < original.size(); i++) {
+		for (int k = 0; k < 3; k++) position_error = std::max(position_error, std::fabs(original[i].pos[k] - decoded[i].pos[k]));
+		float length = glm::length(original[i].normal);
+		if (length > 0.0f) normal_error = std::max(normal_error, glm::length(original[i].normal / length - decoded[i].normal));
+		uv_exact = uv_exact && original[i].texCoord == decoded[i].texCoord;
+	}
+	std::cout << name << ": max position error " << position_error << ", max normal error "
+		<< normal_error << ", uv " << (uv_exact ? "exact" : "NOT exact") << std::endl;
+}
+
+template <typename T, typename Encode, typename Decode>
+void bench_stream(std::string name, const std::vector<T>& values, Encode encode, Decode decode, std::vector<T>& decoded) {
+	std::vector<char> encoded;
+	encode(values.data(), values.size(), encoded);
+	decoded.resize(values.size());
+	size_t raw_size = values.size() * sizeof(T);
+	double parallel_seconds = best_seconds(5, [&]() { decode(encoded.data(), encoded.size(), decoded.data()); });
+	std::cout << name << ": " << raw_size / 1000000.0 << " MB raw, " << encoded.size() / 1000000.0 << " MB encoded, ratio "
+		<< double(raw_size) / encoded.size() << ", decode " << raw_size / parallel_seconds / 1e9 << " GB/s on "
+		<< get_num_workers() << " workers" << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+	// generate the geometry
+	int rings = argc > 1 ? std::stoi(argv[1]) : 1000;
+	std::vector<Vertex> original_vertices;
+	std::vector<VertexWithTangent> original_vertices_with_tangent;
+	std::vector<uint32_t> original_indices;
+	generate_sphere(rings, 2 * rings, original_vertices_with_tangent, original_indices);
+	for (const VertexWithTangent& vertex : original_vertices_with_tangent) {
+		original_vertices.push_back(Vertex(vertex.pos, vertex.normal, vertex.texCoord));
+	}
+
+	// encode, decode and compare
+	std::vector<Vertex> vertices;
+	std::vector<VertexWithTangent> vertices_with_tangent;
+	std::vector<uint32_t> indices;
+	bench_stream("vertices", original_vertices,
+		[](const Vertex* v, size_t n, std::vector<char>& e) { encode_vertices(v, n, e); },
+		[](const char* e, size_t s, Vertex* v) { return decode_vertices(e, s, v); }, vertices);
+	bench_stream("vertices with tangent", original_vertices_with_tangent,
+		[](const VertexWithTangent* v, size_t n, std::vector<char>& e) { encode_vertices(v, n, e); },
+		[](const char* e, size_t s, VertexWithTangent* v) { return decode_vertices(e, s, v); }, vertices_with_tangent);
+	bench_stream("indices", original_indices, encode_indices, decode_indices, indices);
+
+	report_vertex_error("vertices", original_vertices, vertices);
+	report_vertex_error("vertices with tangent", original_vertices_with_tangent, vertices_with_tangent);
+	bool tangents_exact = true;
+	for (size_t i = 0; i < vertices_with_tangent.size(); i++) {
+		tangents_exact = tangents_exact && vertices_with_tangent[i].tangent == original_vertices_with_tangent[i].tangent;
+	}
+	std::cout << "tangents " << (tangents_exact ? "exact" : "NOT exact") << ", indices "
+		<< (indices == original_indices ? "exact" : "NOT exact") << std::endl;
+	return 0;
+}
\ No newline at end of file
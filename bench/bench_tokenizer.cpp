@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "string_utils.h"
+
+/*
+Compares the old split + std::stof/std::stoi line parsing with the string_view
+tokenizer and the std::from_chars number parser on the lines of an obj file.
+
+usage: bench_tokenizer [path to an obj file]
+
+Without a path a synthetic obj file is generated in memory.
+*/
+
+std::string generate_obj(int num_vertices) {
+	std::string text;
+	for (int i = 0; i < num_vertices; i++) {
+		float x = (i % 1000) * 0.137f - 42.5f;
+		float y = (i % 777) * -0.0419f + 3.25f;
+		float z = (i % 313) * 1.0031f;
+		text += "v " + std::to_string(x) + " " + std::to_string(y) + " " + std::to_string(z) + "\n";
+		text += "vn " + std::to_string(x / 100.0f) + " " + std::to_string(y / 100.0f) + " " + std::to_string(z / 100.0f) + "\n";
+		text += "vt " + std::to_string((i % 97) / 97.0f) + " " + std::to_string((i % 89) / 89.0f) + "\n";
+	}
+	for (int i = 0; i + 3 <= num_vertices; i += 3) {
+		text += "f";
+		for (int k = 1; k <= 3; k++) {
+			std::string index = std::to_string(i + k);
+			text += " " + index + "/" + index + "/" + index;
+		}
+		text += "\n";
+	}
+	return text;
+}
+
+std::vector<std::string> read_lines(std::string text) {
+	std::vector<std::string> lines;
+	std::string_view view = text;
+	while (!view.empty()) lines.emplace_back(next_token(view, '\n'));
+	return lines;
+}
+
+double parse_with_split(const std::vector<std::string>& lines) {
+	double checksum = 0.0;
+	for (const std::string& line : lines) {
+		if (line[0] == 'v') {
+			std::vector<std::string> values = split(line, ' ');
+			for (int i = 1; i < values.size(); i++) checksum += std::stof(values[i]);
+		}
+		if (line[0] == 'f') {
+			std::vector<std::string> face_vertices = split(line.substr(2), ' ');
+			for (int k = 0; k < face_vertices.size(); k++) {
+				std::vector<std::string> indices = split(face_vertices[k], '/');
+				for (int i = 0; i < indices.size(); i++) checksum += std::stoi(indices[i]);
+			}
+		}
+	}
+	return checksum;
+}
+
+double parse_with_tokenizer(const std::vector<std::string>& lines) {
+	double checksum = 0.0;
+	for (const std::string& line : lines) {
+		std::string_view view = line;
+		if (char_at(view, 0) == 'v') {
+			next_token(view, ' ');
+			float value;
+			while (!view.empty()) {
+				if (parse_float(next_token(view, ' '), value)) checksum += value;
+			}
+		}
+		if (char_at(view, 0) == 'f') {
+			view.remove_prefix(2);
+			while (!view.empty()) {
+				std::string_view face_vertex = next_token(view, ' ');
+				int index;
+				while (!face_vertex.empty()) {
+					if (parse_int(next_token(face_vertex, '/'), index)) checksum += index;
+				}
+			}
+		}
+	}
+	return checksum;
+}
+
+void report(std::string name, size_t num_lines, double seconds, double checksum) {
+	std::cout << name << ": " << seconds * 1000.0 << " ms, "
+		<< num_lines / seconds / 1000000.0 << " M lines/s (checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+	// load or generate the obj file
+	std::string text;
+	if (argc > 1) {
+		std::ifstream file(argv[1]);
+		if (file.fail()) {
+			std::cerr << "failed to open " << argv[1] << std::endl;
+			return 1;
+		}
+		text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	} else text = generate_obj(1000000);
+	std::vector<std::string> lines = read_lines(text);
+
+	// keep the fastest of a few runs
+	const int num_runs = 5;
+	double split_seconds = 1e30;
+	double tokenizer_seconds = 1e30;
+	double split_checksum = 0.0;
+	double tokenizer_checksum = 0.0;
+	for (int run = 0; run < num_runs; run++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		split_checksum = parse_with_split(lines);
+		auto middle = std::chrono::high_resolution_clock::now();
+		tokenizer_checksum = parse_with_tokenizer(lines);
+		auto end = std::chrono::high_resolution_clock::now();
+		split_seconds = std::min(split_seconds, std::chrono::duration<double>(middle - start).count());
+		tokenizer_seconds = std::min(tokenizer_seconds, std::chrono::duration<double>(end - middle).count());
+	}
+
+	std::cout << lines.size() << " lines" << std::endl;
+	report("split + stof", lines.size(), split_seconds, split_checksum);
+	report("tokenizer + from_chars", lines.size(), tokenizer_seconds, tokenizer_checksum);
+	std::cout << "speedup: " << split_seconds / tokenizer_seconds << "x" << std::endl;
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+A bounding volume hierarchy over boxes, built top down with the surface area
+heuristic. The centroids of the boxes of a node are sorted into BVH_BINS bins
+along every axis and the node is split between the two bins with the lowest
+cost, relative to the area of the node:
+
+	cost = 1 + (count_left * area_left + count_right * area_right) / area
+
+and kept as a leaf when that is not cheaper than testing all its boxes. The
+nodes with many boxes are binned on all the cores, and below the top levels
+the subtrees are built on all the cores.
+
+The root is node 0. The children of an inner node are next to each other and
+come after it, a leaf has count boxes in the indices, and the boxes of any
+subtree are one range of the indices.
+*/
+
+const int BVH_BINS = 16;
+
+// a leaf with more boxes is split even when the split costs more
+const uint32_t BVH_MAX_LEAF_SIZE = 8;
+
+// the deepest a tree gets, the traversals keep a stack of this size
+const uint32_t BVH_MAX_DEPTH = 64;
+
+struct BvhBox {
+	glm::vec3 low;
+	glm::vec3 high;
+};
+
+struct BvhNode {
+	/*
+	A box around a subtree. first is the left child of an inner node, whose
+	count is 0, and the first index of a leaf
+	*/
+	glm::vec3 aabb_min;
+	uint32_t first;
+	glm::vec3 aabb_max;
+	uint32_t count;
+};
+
+static_assert(sizeof(BvhNode) == 32, "a bvh node is cached as 32 bytes");
+
+struct Bvh {
+	std::vector<BvhNode> nodes;
+
+	// the boxes the bvh was built over, in the order of the leaves
+	std::vector<uint32_t> indices;
+};
+
+struct SceneBvh {
+	/*
+	The bvh of a scene in two levels: the top level over the world bounds of
+	the meshes, the meshes before the meshes with normal map, and a bottom
+	level per mesh over its triangles in the space of the mesh
+	*/
+	Bvh top;
+	std::vector<Bvh> bottom;
+
+	// the inverse of the transform of every mesh, to move the rays into the
+	// bottom levels
+	std::vector<glm::mat4> world_to_mesh;
+};
+
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+
+	// the reciprocal of the direction, for the box tests
+	glm::vec3 inverse_direction;
+
+	Ray(glm::vec3 origin_, glm::vec3 direction_);
+};
+
+struct TriangleMesh {
+	/*
+	Indexed triangles over the positions of any vertex type, vertices points
+	at the position of the first vertex
+	*/
+	const char* vertices;
+	size_t vertex_stride;
+	const uint32_t* indices;
+	uint32_t triangle_count;
+
+	glm::vec3 position(uint32_t vertex) const {
+		return *reinterpret_cast<const glm::vec3*>(vertices + vertex_stride * vertex);
+	}
+};
+
+// build a bvh over boxes, parallel uses all the cores
+Bvh build_bvh(const std::vector<BvhBox>& boxes, bool parallel);
+
+// the boxes of the triangles of a mesh, to build its bvh over
+std::vector<BvhBox> triangle_boxes(const TriangleMesh& mesh);
+
+// true if every node and index of a bvh over primitive_count boxes is in
+// range, every node but the root has one parent, and the tree is no deeper
+// than BVH_MAX_DEPTH
+bool valid_bvh(const Bvh& bvh, uint32_t primitive_count);
+
+// the hit of a ray with a triangle between 0 and t_max, and its distance
+bool intersect_triangle(const Ray& ray, glm::vec3 a, glm::vec3 b, glm::vec3 c, float t_max, float& t);
+
+// the nearest hit of a ray with the triangles of a mesh closer than t_max,
+// t_max becomes the distance of the hit
+bool intersect_triangles(const Bvh& bvh, const TriangleMesh& mesh, const Ray& ray, float& t_max, uint32_t& triangle);
+
+inline bool intersect_box(const Ray& ray, const BvhNode& node, float t_max, float& t_near) {
+	glm::vec3 t0 = (node.aabb_min - ray.origin) * ray.inverse_direction;
+	glm::vec3 t1 = (node.aabb_max - ray.origin) * ray.inverse_direction;
+	glm::vec3 enter = glm::min(t0, t1);
+	glm::vec3 leave = glm::max(t0, t1);
+	t_near = std::max(std::max(enter.x, enter.y), std::max(enter.z, 0.0f));
+	float t_far = std::min(std::min(leave.x, leave.y), std::min(leave.z, t_max));
+	return t_near <= t_far;
+}
+
+template <typename VisitLeaf>
+void traverse_bvh(const Bvh& bvh, const Ray& ray, float& t_max, VisitLeaf visit_leaf) {
+	/*
+	Visit the boxes of the leaves a ray enters before t_max, nearer children
+	first. visit_leaf(index, t_max) is called for every box of those leaves
+	and lowers t_max when it hits something, which skips what is behind it.
+	*/
+	float t;
+	if (bvh.nodes.empty() || !intersect_box(ray, bvh.nodes[0], t_max, t)) return;
+
+	// the farther children still to visit and where the ray enters them
+	uint32_t stack[BVH_MAX_DEPTH];
+	float stack_t[BVH_MAX_DEPTH];
+	uint32_t stack_size = 0;
+	uint32_t node_index = 0;
+	while (true) {
+		const BvhNode& node = bvh.nodes[node_index];
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++) visit_leaf(bvh.indices[i], t_max);
+		} else {
+			float t_left, t_right;
+			bool left = intersect_box(ray, bvh.nodes[node.first], t_max, t_left);
+			bool right = intersect_box(ray, bvh.nodes[node.first + 1], t_max, t_right);
+			if (left && right) {
+				bool left_first = t_left <= t_right;
+				stack[stack_size] = left_first ? node.first + 1 : node.first;
+				stack_t[stack_size++] = left_first ? t_right : t_left;
+				node_index = left_first ? node.first : node.first + 1;
+				continue;
+			}
+			if (left || right) {
+				node_index = left ? node.first : node.first + 1;
+				continue;
+			}
+		}
+
+		// the next farther child the ray still enters before the nearest hit
+		do {
+			if (stack_size == 0) return;
+			stack_size--;
+		} while (stack_t[stack_size] > t_max);
+		node_index = stack[stack_size];
+	}
+}
\ No newline at end of file
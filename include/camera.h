@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <glm/vec3.hpp>
 #include <GLFW/glfw3.h>
 
@@ -24,6 +25,10 @@ struct Camera {
 	// cursor coordinates
 	float lastX, lastY;
 
+	// where the camera ends up moving from one position toward another, it
+	// moves straight there without one
+	std::function<glm::vec3(glm::vec3, glm::vec3)> collide;
+
 	// constructors
 	Camera(glm::vec3 pos, glm::vec3 front, glm::vec3 up);
 	Camera();
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "scene.h"
+
+/*
+The draws of a frame in the order they are recorded. The draws are bucketed by
+material when the scene is loaded, and every frame they are sorted by a packed
+key: the pipeline, then the texture, then the depth front to back. Recording
+the sorted draws binds each pipeline once, every draw finds its textures in
+its draw data through its first instance.
+
+The draws in their load order are also written once as indirect commands, the
+first instance of every command is its draw, which finds its draw data with
+it. The draws with normal map come after the others, so each pipeline draws a
+single range.
+
+	bits 63-60    pipeline
+	bits 59-32    texture
+	bits 31-0     depth, the bits of a non-negative float sort like the float
+*/
+
+// the pipelines a draw can use, in the order they are drawn
+enum DrawPipeline {
+	DRAW_PIPELINE_BASIC,
+	DRAW_PIPELINE_BASIC_T,
+	DRAW_PIPELINE_NORMAL_MAPPING
+};
+
+struct Draw {
+	/*
+	A mesh ready to record: its material, its model matrix, its range in the
+	index buffer, and its bounds
+	*/
+	DrawPipeline pipeline;
+	bool with_normal_map;
+	uint32_t texture_index;
+
+	// in the texture table, after the textures
+	uint32_t normal_map_index;
+
+	glm::mat4 model;
+	uint32_t index_count;
+	uint32_t index_offset;
+	int32_t vertex_offset;
+	MeshBounds bounds;
+
+	// the mesh drawn, the meshes before the meshes with normal map
+	uint32_t mesh;
+};
+
+struct DrawStats {
+	/*
+	What recording the draws of a frame cost
+	*/
+	int draws;
+	int draw_calls;
+	int pipeline_binds;
+	int descriptor_binds;
+};
+
+// pack the sort key of a draw
+uint64_t draw_key(DrawPipeline pipeline, uint32_t texture_index, float depth);
+
+class DrawList {
+public:
+
+	// every draw of the scene, grouped by material
+	std::vector<Draw> draws;
+
+	// the draws in the order of the last sort
+	std::vector<uint32_t> order;
+
+	// the number of materials the draws were grouped in, and where the draws
+	// with normal map start
+	int num_buckets;
+	uint32_t first_with_normal_map;
+
+	// make a draw of every mesh with a texture
+	void build(const Scene& scene);
+
+	// pick the pipeline of every draw and sort the draws by their keys, seen
+	// from eye looking along forward
+	void sort(glm::vec3 eye, glm::vec3 forward, bool normal_mapping);
+
+	// the draw data of every draw, indexed by the instance index
+	std::vector<DrawData> draw_data() const;
+
+	// an indirect command of every draw in load order
+	std::vector<VkDrawIndexedIndirectCommand> indirect_commands() const;
+
+	// the bounds of every draw in load order
+	std::vector<MeshBounds> bounds() const;
+
+private:
+
+	// the keys of the last sort with the draws they belong to
+	std::vector<std::pair<uint64_t, uint32_t>> keys;
+};
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "scene.h"
+#include "vertex.h"
+
+/*
+Frustum culling of boxes on the CPU, eight at a time. The boxes are kept as
+centers and half extents in separate arrays padded to a multiple of eight,
+so every plane is tested against eight boxes with a few vector operations.
+With AVX the eight boxes are one register, otherwise two SSE registers, and
+a plain loop without either.
+
+A box is outside when it is fully behind one of the planes:
+
+	dot(normal, center) + dot(abs(normal), extent) + distance < 0
+*/
+
+// the bounds of the transformed vertices of a mesh
+MeshBounds mesh_bounds(const Vertex* vertices, int vertex_count, const glm::mat4& transform);
+MeshBounds mesh_bounds(const VertexWithTangent* vertices, int vertex_count, const glm::mat4& transform);
+
+class FrustumCuller {
+public:
+
+	// what the last cull found
+	uint32_t num_tested;
+	uint32_t num_culled;
+
+	FrustumCuller();
+
+	// the boxes to test, replacing the ones before
+	void setBounds(const std::vector<MeshBounds>& bounds);
+
+	// test every box against the frustum of a projection times view matrix,
+	// visible gets a 1 for every box that may be in it and a 0 for the others
+	void cull(const glm::mat4& view_projection, std::vector<uint8_t>& visible);
+
+	// the share of the boxes the last cull culled, 0 to 100
+	float culledPercent() const;
+
+private:
+	uint32_t count;
+	std::vector<float> center_x, center_y, center_z;
+	std::vector<float> extent_x, extent_y, extent_z;
+};
\ No newline at end of file
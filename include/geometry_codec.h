@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vertex.h"
+
+/*
+A compact encoding for the vertex and index streams of the scene cache.
+
+The streams are cut into blocks that are encoded and decoded independently,
+so both directions run on all the cores. Inside a block every vertex
+attribute is a channel of 32-bit values:
+
+	position    quantized to 16 bits inside the bounding box of the block
+	normal      octahedral, 16 bits per coordinate
+	uv, tangent the float bits, kept exactly
+
+Each channel is delta coded against the previous vertex and zigzag mapped
+so small changes become small numbers, and the numbers are packed with
+stream vbyte: a 2-bit length per value in a control stream and the value
+bytes in a data stream, which decodes 4 values per SIMD shuffle. Indices
+are delta coded the same way without quantization, so they are exact.
+
+An encoded stream is
+
+	uint64_t count          number of vertices or indices
+	uint64_t block_count
+	uint64_t block_offsets[block_count + 1], from the start of the stream
+	the blocks
+*/
+
+const size_t CODEC_VERTEX_BLOCK_SIZE = 4096;
+const size_t CODEC_INDEX_BLOCK_SIZE = 16384;
+
+// encode a stream
+void encode_vertices(const Vertex* vertices, size_t count, std::vector<char>& encoded);
+void encode_vertices(const VertexWithTangent* vertices, size_t count, std::vector<char>& encoded);
+void encode_indices(const uint32_t* indices, size_t count, std::vector<char>& encoded);
+
+// number of values in an encoded stream, or false if the stream is broken
+bool encoded_count(const char* encoded, size_t size, uint64_t& count);
+
+// decode a stream into room for encoded_count values, returns false if the
+// stream is broken
+bool decode_vertices(const char* encoded, size_t size, Vertex* vertices);
+bool decode_vertices(const char* encoded, size_t size, VertexWithTangent* vertices);
+bool decode_indices(const char* encoded, size_t size, uint32_t* indices);
\ No newline at end of file
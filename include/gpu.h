@@ -26,6 +26,14 @@ public:
 	VkPhysicalDevice physical_gpu;
 	VkDevice logical_gpu;
 	uint64_t min_uboOffset;
+	bool textureCompressionBC;
+	uint32_t maxSampledImages;
+
+	// whether draws can be submitted many at a time from an indirect buffer,
+	// and vkCmdDrawIndexedIndirectCountKHR if the device has it
+	bool multiDrawIndirect;
+	uint32_t maxDrawIndirectCount;
+	PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount;
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
 	VkCommandPool commandPool;
@@ -48,14 +56,14 @@ public:
 
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 
-	void createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples, VkFormat format, VkImageUsageFlags usage, VkImage& image);
+	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageUsageFlags usage, VkImage& image);
 
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
 
 private:
 	void pickPhysicalDevice(VkInstance vulkan_instance, VkSurfaceKHR surface);
 
-	void createLogicalDevice(VkSurfaceKHR surface, QueueFamilyIndices& indices);
+	void createLogicalDevice(VkInstance vulkan_instance, QueueFamilyIndices& indices);
 
 	void createCommandPool(QueueFamilyIndices& indices);
 };
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// a fast 64-bit hash of a block of memory, not meant for security
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0);
+
+// mix a value into a running hash
+uint64_t hash_combine(uint64_t seed, uint64_t value);
+
+// hash_bytes over a large block on all the cores, the result doesn't depend
+// on the number of cores
+uint64_t hash_bytes_parallel(const void* data, size_t size);
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "texture_compression.h"
+
+enum ImageEncoding {
+	/*
+	How the pixels of an image are stored in the staging buffer
+	*/
+	ENCODING_RAW,
+
+	// BC1, or BC3 if the image has transparent pixels
+	ENCODING_COLOR_BC,
+
+	// BC5, the red and green channels of a normal map
+	ENCODING_NORMAL_BC
+};
+
+struct ImageSlot {
+	/*
+	An image file and the part of a staging buffer its pixels are decoded to
+	*/
+	std::string file_path;
+	int width;
+	int height;
+	uint64_t offset;
+	uint64_t size;
+	double decode_time;
+
+	// number of levels of the full mip chain, and the offsets of the levels
+	// that are in the staging buffer, only level 0 unless the chain is built
+	// on the CPU
+	uint32_t mip_levels;
+	std::vector<uint64_t> level_offsets;
+
+	// the level of the image the slot starts at, 0 unless the slot only holds
+	// the smaller levels. width, height and mip_levels are then those of the
+	// levels in the slot.
+	uint32_t first_level;
+
+	// the encoding asked for, and the block format that was chosen when the
+	// image was decoded
+	ImageEncoding encoding;
+	BlockFormat format;
+
+	// the cooked texture of the image, empty if it is not in the texture cache
+	std::string cooked_path;
+};
+
+// the levels of a slot are aligned to 4 * num_channels bytes, or 16 for a
+// block format. A slot that starts at a multiple of this, a common multiple
+// of every one of those alignments, keeps all its levels aligned wherever it
+// is placed.
+const uint64_t IMAGE_SLOT_ALIGNMENT = 48;
+
+// number of levels of the full mip chain of an image, down to 1x1
+uint32_t mip_level_count(int width, int height);
+
+// bytes of one mip level of width x height pixels with num_channels channels,
+// or in a block format
+uint64_t level_size(int width, int height, int num_channels, BlockFormat format);
+
+// read the sizes of the images from their headers and give each image a slot
+// of 8-bit pixels with num_channels channels, with room for the whole mip
+// chain if cpu_mip_chain is set. Block compressed images always get the whole
+// chain and need 4 channels. total_size is the size of the staging buffer the
+// slots are in.
+std::vector<ImageSlot> plan_image_slots(
+	const std::vector<std::string>& file_paths,
+	int num_channels,
+	ImageEncoding encoding,
+	bool cpu_mip_chain,
+	uint64_t& total_size
+);
+
+// the slot of the levels from first_level on of a slot with the whole mip
+// chain, starting at offset 0
+ImageSlot image_slot_levels(const ImageSlot& slot, uint32_t first_level);
+
+// decode one image straight into its slot of a staging buffer, flipped
+// vertically and expanded to num_channels channels, then fill the mip levels
+// that have room in the slot with a box filter, in linear space if the image
+// is srgb, and compress the levels if the slot is block compressed
+void decode_image(ImageSlot& slot, int num_channels, bool srgb, char* staging);
+
+// print how much GPU memory the images take and how much the block
+// compression saved against num_channels uncompressed channels
+void report_texture_memory(std::string name, const std::vector<ImageSlot>& slots, int num_channels);
+
+// print how long decoding took on the wall clock and in total, and the
+// slowest images
+void report_decode_times(std::string name, const std::vector<ImageSlot>& slots, double wall_time);
\ No newline at end of file
@@ -6,9 +6,14 @@
 #include "vertex.h"
 #include "scene.h"
 
-// load obj from scratch
+// load obj from scratch, compress_cache writes the cache with the geometry
+// codec (smaller, positions and normals quantized). Materials always share
+// the images with the same path, dedup_textures_by_content also merges the
+// images whose files have the same contents.
 void load_meshes_and_textures_obj(
 	Scene* scene,
 	std::string obj_path,
-	std::string mtl_path
+	std::string mtl_path,
+	bool compress_cache = false,
+	bool dedup_textures_by_content = false
 );
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+class MappedFile {
+public:
+
+	// the file contents, valid until the file is unmapped
+	const char* data;
+	size_t size;
+
+	// constructor, maps the whole file read-only
+	MappedFile(std::string path);
+
+	// destructor
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// the whole file as text
+	std::string_view text() const;
+
+private:
+
+	// platform handles
+	void* file_handle;
+	void* mapping_handle;
+};
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+struct ObjGroup {
+	/*
+	The faces of one object and material. The faces are stored already
+	parsed: face i has face_sizes[i] vertices and each vertex is a 1-based
+	(position, uv, normal) index triplet in vertex_indices.
+	*/
+	std::vector<int> face_sizes;
+	std::vector<int> vertex_indices;
+	std::string material;
+	std::string debug_node_name;
+};
+
+struct ObjData {
+	/*
+	The records of an obj file. The groups are in the order they appear in
+	the file.
+	*/
+	std::vector<glm::vec3> coordinates;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> uv;
+	std::vector<ObjGroup> groups;
+};
+
+// map the obj file and parse it on all the cores
+void parse_obj(std::string obj_path, ObjData& data);
\ No newline at end of file
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "buffer.h"
+#include "draw_list.h"
+#include "gpu.h"
+#include "pipeline.h"
+#include "staging_ring.h"
+
+/*
+Culling of the draws on the GPU, against the frustum and against a depth
+pyramid of what was drawn, in two phases around the depth of the frame:
+
+	early    the draws visible in the last frame that are in the frustum are
+	         drawn, and the pyramid is built from their depth
+	late     every draw is tested against the frustum and the pyramid, the
+	         visible ones that were not drawn early are drawn, and what is
+	         visible is kept for the next frame
+
+A draw that comes into view is drawn in the late phase of the same frame, so
+nothing pops in a frame late. Each phase compacts the commands of the draws
+that pass into the range of their pipeline, and counts them for the count
+variant of the indirect draw.
+*/
+
+// the most levels the depth pyramid can have
+const uint32_t DEPTH_PYRAMID_MAX_LEVELS = 16;
+
+struct CullConstants {
+	/*
+	The push constants of cull.comp
+	*/
+	glm::mat4 view;
+	glm::vec4 frustum;
+	glm::vec4 projection;
+	glm::vec4 depth;
+	uint32_t draw_count;
+	uint32_t first_with_normal_map;
+	uint32_t phase;
+	uint32_t occlusion;
+};
+
+struct CullStats {
+	/*
+	What the late phase of a frame found, and the draws of both phases
+	*/
+	uint32_t tested;
+	uint32_t frustum_culled;
+	uint32_t occlusion_culled;
+	uint32_t drawn;
+};
+
+class OcclusionCulling {
+public:
+
+	// the GPU the culling runs on
+	GPU* gpu;
+
+	// the commands of the draws that passed, at the start of their pipeline
+	// range like in the draw list, and the number of them in each range
+	Buffer* commands;
+	Buffer* counts;
+
+	// whether the late phase tests the depth pyramid, or only the frustum
+	bool occlusion;
+
+	// the stats of the newest frame that was read back
+	CullStats stats;
+
+	// constructor, the draws are culled in their load order and read their
+	// commands from indirect_buffer
+	OcclusionCulling(GPU* gpu_, const DrawList& draw_list, Buffer* indirect_buffer, StagingRing* staging_ring);
+
+	// destructor, the pyramid has to be destroyed first
+	~OcclusionCulling();
+
+	OcclusionCulling(const OcclusionCulling&) = delete;
+	OcclusionCulling& operator=(const OcclusionCulling&) = delete;
+
+	// make the depth pyramid of a depth buffer, again whenever the depth
+	// buffer is made again
+	void createPyramid(VkImageView depth_view, VkExtent2D extent, VkSampleCountFlagBits samples);
+	void destroyPyramid();
+
+	// take the stats a frame copied back, once its fence is signaled
+	void readStats(uint32_t frame);
+
+	// record the early phase, before the early render pass
+	void cullEarly(VkCommandBuffer command_buffer, const glm::mat4& view, const glm::mat4& projection);
+
+	// record the pyramid of the early depth, after the early render pass
+	void buildPyramid(VkCommandBuffer command_buffer);
+
+	// record the late phase and the copy of the stats of a frame, before the
+	// late render pass
+	void cullLate(VkCommandBuffer command_buffer, const glm::mat4& view, const glm::mat4& projection, uint32_t frame);
+
+private:
+
+	uint32_t draw_count;
+	uint32_t first_with_normal_map;
+
+	// the bounding sphere of every draw, whether it was visible, what the
+	// late phase counted, and a host copy of the stats for every frame
+	Buffer* bounds;
+	Buffer* visibility;
+	Buffer* stats_buffer;
+	std::vector<Buffer*> readback;
+	std::vector<CullStats*> readback_mapped;
+
+	ComputePipeline cull_pipeline;
+	ComputePipeline pyramid_init_pipeline;
+	ComputePipeline pyramid_init_ms_pipeline;
+	ComputePipeline pyramid_pipeline;
+
+	VkDescriptorSetLayout cull_layout;
+	VkDescriptorSetLayout pyramid_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet cull_set;
+	VkDescriptorSet pyramid_sets[DEPTH_PYRAMID_MAX_LEVELS];
+	VkSampler sampler;
+
+	// the depth pyramid, the power of two below the depth buffer with every
+	// level down to 1x1, always in the general layout
+	VkImage pyramid;
+	VkDeviceMemory pyramid_memory;
+	VkImageView pyramid_view;
+	std::vector<VkImageView> level_views;
+	uint32_t pyramid_width;
+	uint32_t pyramid_height;
+	VkSampleCountFlagBits depth_samples;
+
+	// record the cull shader for a phase
+	void cull(VkCommandBuffer command_buffer, const glm::mat4& view, const glm::mat4& projection, uint32_t phase);
+};
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <functional>
+
+// number of worker threads to use for parallel work
+int get_num_workers();
+
+// run task(0), ..., task(count - 1) on all the cores and wait for them to finish
+void parallel_for(int count, std::function<void(int)> task);
\ No newline at end of file
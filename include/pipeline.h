@@ -18,7 +18,21 @@ public:
 		std::string vertex_shader, std::string fragment_shader,
 		VkVertexInputBindingDescription bindingDescription,
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions,
-		std::vector<VkDescriptorSetLayout>& setLayouts
+		std::vector<VkDescriptorSetLayout>& setLayouts,
+		std::vector<VkPushConstantRange>& pushConstantRanges
+	);
+};
+
+class ComputePipeline {
+public:
+	VkPipeline pipeline;
+	VkPipelineLayout layout;
+
+	ComputePipeline();
+	void create(
+		GPU* gpu, std::string compute_shader,
+		std::vector<VkDescriptorSetLayout>& setLayouts,
+		std::vector<VkPushConstantRange>& pushConstantRanges
 	);
 };
 
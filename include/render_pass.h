@@ -2,13 +2,22 @@
 
 #include <vulkan/vulkan.h>
 
+// a frame drawn in one pass, or in an early pass that keeps its depth for the
+// compute work between the passes and a late pass that draws over it
+enum RenderPassPhase {
+	RENDER_PASS_WHOLE,
+	RENDER_PASS_EARLY,
+	RENDER_PASS_LATE
+};
+
 class RenderPass {
 private:
 	VkRenderPass renderPass;
 	VkDevice device;
 
 public:
-	RenderPass(VkDevice d, VkFormat color_format, VkFormat depth_format, VkSampleCountFlagBits msaaSamples);
+	RenderPass(VkDevice d, VkFormat color_format, VkFormat depth_format, VkSampleCountFlagBits msaaSamples,
+		RenderPassPhase phase = RENDER_PASS_WHOLE);
 	~RenderPass();
 	VkRenderPass getRenderPass();
 };
\ No newline at end of file
@@ -3,50 +3,54 @@
 #include <vector>
 #include <fstream>
 
+#include "bvh.h"
 #include "vertex.h"
 #include "light.h"
 #include "camera.h"
 #include "buffer.h"
+#include "staging_ring.h"
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+struct MeshBounds {
+	/*
+	The box around the transformed vertices of a mesh, and the sphere around
+	the center of the box
+	*/
+	glm::vec3 aabb_min;
+	glm::vec3 aabb_max;
+	glm::vec3 center;
+	float radius;
+};
+
 class MeshBase {
 	/*
-	The base mesh class. Every mesh have indices, an initial transformation,
-	an index offset, a vertex offset, a diffuse texture index
+	The base mesh class. Every mesh have an initial transformation, a range
+	of indices and a range of vertices in the scene geometry, and a diffuse
+	texture index
 	*/
 public:
-	std::vector<uint32_t> indices;
 	glm::mat4 init_transform;
 	int index_offset;
+	int index_count;
 	int vertex_offset;
+	int vertex_count;
 	int texture_index;
 	std::string debug_node_name;
+
+	// in world space, the meshes don't move
+	MeshBounds bounds;
 };
 
 class Mesh : public MeshBase {
-public:
-	std::vector<Vertex> vertices;
-
-	// serialize this mesh to the file
-	void serialize(std::ofstream& file);
-
-	// deserialize the mesh from the file
-	void deserialize(std::ifstream& file);
 };
 
 class MeshWithNormalMap : public MeshBase {
 public:
-	std::vector<VertexWithTangent> vertices;
 	int normal_map_index;
 
-	// serialize this mesh to the file
-	void serialize(std::ofstream& file);
-
-	// deserialize the mesh from the file
-	void deserialize(std::ifstream& file);
-
-	void calculate_tangent_vectors();
+	// vertices and indices point to the start of this mesh's ranges
+	void calculate_tangent_vectors(VertexWithTangent* vertices, const uint32_t* indices);
 };
 
 struct Texture {
@@ -55,12 +59,6 @@ struct Texture {
 	// constructor
 	Texture();
 	Texture(std::string path);
-
-	// serialize this texture to the file
-	void serialize(std::ofstream& file);
-
-	// deserialize this texture from the file
-	void deserialize(std::ifstream& file);
 };
 
 struct NormalMap {
@@ -69,12 +67,6 @@ struct NormalMap {
 	// constructor
 	NormalMap();
 	NormalMap(std::string path);
-
-	// serialize this normal map to the file
-	void serialize(std::ofstream& file);
-
-	// deserialize this normal map from the file
-	void deserialize(std::ifstream& file);
 };
 
 struct ViewProjectrion {
@@ -87,16 +79,35 @@ struct FragmentUniform {
 	alignas(16) glm::vec3 eye;
 };
 
+// what a draw looks up through its instance index, laid out like the std430
+// buffer of the vertex shaders
+struct DrawData {
+	glm::mat4 model;
+	uint32_t texture_index;
+	uint32_t normal_map_index;
+	uint32_t padding[2];
+};
+
 class Scene {
 public:
 	std::vector<Mesh> meshes;
 	std::vector<MeshWithNormalMap> meshes_with_normal_map;
+
+	// the geometry of all the meshes, laid out the way the vertex and index
+	// buffers expect: a vertex stream per vertex format and one index stream
+	// with the meshes before the meshes with normal map
+	std::vector<Vertex> vertices;
+	std::vector<VertexWithTangent> vertices_with_tangent;
+	std::vector<uint32_t> indices;
+
+	// the bvh over the meshes and their triangles, built with the geometry
+	SceneBvh bvh;
+
 	std::vector<Texture> textures;
 	std::vector<NormalMap> normal_maps;
 	std::vector<std::string> debug_node_names;
 	int debug_index;
-	bool debug_press_n;
-	bool debug_press_b;
+	bool debug_press_pick;
 	bool debug_press_t;
 	bool debug_mode;
 	bool enable_normal_map;
@@ -118,9 +129,13 @@ public:
 	// Get the total number of indices in the scene
 	int get_num_indices();
 
-	void createVertexBuffer(GPU* gpu);
+	// upload the vertices through the staging ring, flush the ring before
+	// drawing
+	void createVertexBuffer(GPU* gpu, StagingRing* staging_ring);
 
-	void createIndexBuffer(GPU* gpu);
+	// upload the indices through the staging ring, flush the ring before
+	// drawing
+	void createIndexBuffer(GPU* gpu, StagingRing* staging_ring);
 
 	void createUniformBuffer(GPU* gpu);
 };
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+#include "scene.h"
+
+/*
+Queries of the bvh of a scene. The meshes are numbered like in the top level
+of the bvh, the meshes and then the meshes with normal map. A ray is moved
+into the space of a mesh to test its bottom level, where the distances along
+it stay the same.
+*/
+
+struct RayHit {
+	float t;
+	int mesh;
+	uint32_t triangle;
+
+	// the normal of the triangle in world space, facing the ray
+	glm::vec3 normal;
+};
+
+// the mesh with a number of the top level
+const MeshBase& scene_mesh(const Scene& scene, int mesh);
+
+// the triangles of a mesh in its own space
+TriangleMesh mesh_triangles(const Scene& scene, int mesh);
+
+// build both levels of the bvh of a scene on all the cores, after the
+// geometry and the bounds of the meshes are in place
+void build_scene_bvh(Scene* scene);
+
+// the transforms from world to mesh space, after the bvh is built or read
+void set_bvh_transforms(Scene* scene);
+
+// the nearest triangle a ray hits closer than t_max
+bool intersect_scene(const Scene& scene, const Ray& ray, float t_max, RayHit& hit);
+
+// test the meshes against the frustum of a projection times view matrix
+// through the top level, whole subtrees are accepted or rejected at once.
+// visible gets a 1 for every mesh that may be in it, returns the number of
+// nodes visited.
+uint32_t cull_scene(const Scene& scene, const glm::mat4& view_projection, std::vector<uint8_t>& visible);
+
+// where a sphere of radius ends up moving from one point toward another, it
+// stops short of the triangles in its way and slides along them. The path
+// of its center is tested, so it can brush past an edge.
+glm::vec3 collide_movement(const Scene& scene, glm::vec3 from, glm::vec3 to, float radius);
\ No newline at end of file
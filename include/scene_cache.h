@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "scene.h"
+
+/*
+The scene cache file:
+
+	SceneCacheHeader
+	SceneCacheSection[section_count]      the section directory
+	section data                          each section starts at a multiple of
+	                                      SCENE_CACHE_ALIGNMENT
+
+All counts and offsets are 64-bit and relative to the start of the file, so
+the vertex and index sections can be used in place from a mapped file and
+the sections can be read independently of each other.
+*/
+
+// bump this whenever the layout of the cache or of the vertices changes
+const uint32_t SCENE_CACHE_VERSION = 4;
+
+const uint64_t SCENE_CACHE_ALIGNMENT = 64;
+
+enum SceneCacheSectionId {
+	SECTION_VERTICES = 1,
+	SECTION_VERTICES_WITH_TANGENT = 2,
+	SECTION_INDICES = 3,
+	SECTION_MESHES = 4,
+	SECTION_MESHES_WITH_NORMAL_MAP = 5,
+	SECTION_TEXTURES = 6,
+	SECTION_NORMAL_MAPS = 7,
+	SECTION_DEBUG_NODE_NAMES = 8,
+	SECTION_STRINGS = 9,
+	SECTION_SOURCES = 10,
+	SECTION_MESH_SIGNATURES = 11,
+
+	// the geometry encoded with the geometry codec, a cache has either the raw
+	// or the encoded section of each stream
+	SECTION_VERTICES_ENCODED = 12,
+	SECTION_VERTICES_WITH_TANGENT_ENCODED = 13,
+	SECTION_INDICES_ENCODED = 14,
+
+	// the nodes and indices of every bvh of the scene, and the ranges of
+	// every bvh in them: the top level, then the bottom level of every mesh
+	SECTION_BVH_NODES = 15,
+	SECTION_BVH_INDICES = 16,
+	SECTION_BVH_TREES = 17
+};
+
+struct SceneCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t section_count;
+	uint64_t file_size;
+	uint32_t vertex_size;
+	uint32_t vertex_with_tangent_size;
+	uint32_t loader_version;
+	uint32_t reserved_0;
+	uint64_t reserved[3];
+};
+
+struct SceneCacheSection {
+	uint32_t id;
+	uint32_t element_size;
+	uint64_t offset;
+	uint64_t count;
+	uint64_t size;
+};
+
+struct SceneCacheString {
+	/*
+	A string in the strings section
+	*/
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct SceneCacheMesh {
+	/*
+	A mesh record, the ranges point into the vertex and index sections
+	*/
+	glm::mat4 init_transform;
+	uint64_t index_offset;
+	uint64_t index_count;
+	uint64_t vertex_offset;
+	uint64_t vertex_count;
+	int32_t texture_index;
+	int32_t normal_map_index;
+	SceneCacheString debug_node_name;
+
+	// the bounds are stored so a cached scene can be culled without
+	// touching its vertices
+	MeshBounds bounds;
+};
+
+struct SceneCacheBvh {
+	/*
+	A bvh record, the ranges point into the bvh node and index sections
+	*/
+	uint64_t node_offset;
+	uint64_t node_count;
+	uint64_t index_offset;
+	uint64_t index_count;
+};
+
+struct SceneCacheSource {
+	/*
+	A source file record, the path is in the strings section
+	*/
+	SceneCacheString path;
+	uint64_t size;
+	int64_t modified_time;
+	uint64_t hash;
+};
+
+struct SourceFile {
+	std::string path;
+	uint64_t size;
+	int64_t modified_time;
+	uint64_t hash;
+};
+
+struct SceneCacheInfo {
+	/*
+	What a cache was built from: the version of the loader that built it, the
+	source files, and a signature of the input of every mesh, first the
+	meshes and then the meshes with normal map. A mesh whose signature
+	didn't change can be reused when the sources change.
+	*/
+	uint32_t loader_version;
+	std::vector<SourceFile> sources;
+	std::vector<uint64_t> mesh_signatures;
+};
+
+// size, modification time and content hash of a file
+SourceFile describe_source_file(std::string path);
+
+// true if the file still has the recorded contents, the contents are only
+// hashed when the size or the modification time differ
+bool source_file_unchanged(const SourceFile& source);
+
+// write the scene to a cache file on a background thread, compress stores the
+// geometry with the geometry codec, which quantizes the positions and the
+// normals. What the cache is written from is copied first, so the scene can be
+// used and changed as soon as this returns. The file is written under a
+// temporary name and renamed, so a cache is never partly written.
+void start_scene_cache_write(Scene* scene, const SceneCacheInfo& info, std::string cache_path, bool compress);
+
+// wait for the background write, call before exiting
+void finish_scene_cache_write();
+
+// load the scene from a cache file, returns false if the file is not a cache
+// of this version and has to be rebuilt
+bool read_scene_cache(Scene* scene, SceneCacheInfo& info, std::string cache_path);
\ No newline at end of file
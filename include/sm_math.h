@@ -9,6 +9,13 @@ glm::vec3 cross(glm::vec3 x, glm::vec3 y);
 float dot(glm::vec4 x, glm::vec4 y);
 glm::mat4 transpose(glm::mat4 matrix);
 
+// the planes of the view frustum of a projection times view matrix, left,
+// right, bottom, top, near and far, pointing inwards as (normal, distance)
+void frustum_planes(glm::mat4 view_projection, glm::vec4 planes[6]);
+
+// true if any part of the sphere may be inside the frustum
+bool sphere_in_frustum(const glm::vec4 planes[6], glm::vec3 center, float radius);
+
 template<typename T>
 void argsort(std::vector<T>& array, std::vector<int>& out) {
 	/*
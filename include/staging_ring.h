@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "gpu.h"
+
+// the ring is split in this many regions, the CPU fills one region while the
+// GPU copies out of the others
+const uint32_t STAGING_RING_REGIONS = 4;
+
+struct StagingSpan {
+	/*
+	Space in the ring, written through data and copied from offset
+	*/
+	char* data;
+	VkDeviceSize offset;
+};
+
+class StagingRing {
+public:
+
+	// the GPU the uploads go to
+	GPU* gpu;
+
+	// the host visible buffer, mapped for the life of the ring
+	Buffer* buffer;
+
+	// the size of a region, the most that can be uploaded in one piece
+	VkDeviceSize region_size;
+
+	// what went through the ring
+	VkDeviceSize bytes_uploaded;
+	uint32_t num_submits;
+
+	// constructor, size is the whole ring
+	StagingRing(GPU* gpu_, VkDeviceSize size);
+
+	// destructor, waits for the uploads in flight
+	~StagingRing();
+
+	StagingRing(const StagingRing&) = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+
+	// the command buffer of the current region, the copies out of the region
+	// and the barriers around them are recorded here
+	VkCommandBuffer commandBuffer();
+
+	// take size bytes of the current region, false if they don't fit and the
+	// region has to be submitted first
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, StagingSpan& span);
+
+	// submit the current region and move to the next one, waiting for the
+	// GPU to finish copying out of it
+	void submit();
+
+	// submit the current region and wait for all the uploads
+	void flush();
+
+	// copy a block of memory to a buffer through the ring, in pieces of at
+	// most a region
+	void uploadBuffer(const void* data, VkDeviceSize size, VkBuffer destination, VkDeviceSize destination_offset);
+
+private:
+
+	struct Region {
+		VkCommandBuffer command_buffer;
+		VkFence fence;
+		VkDeviceSize used;
+		bool recording;
+		bool in_flight;
+	};
+
+	char* mapped;
+	std::vector<Region> regions;
+	uint32_t current;
+
+	// wait for the GPU to finish copying out of a region
+	void wait(Region& region);
+};
\ No newline at end of file
@@ -2,5 +2,23 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 
-std::vector<std::string> split(std::string s, char delimiter);
\ No newline at end of file
+std::vector<std::string> split(std::string s, char delimiter);
+
+// position of the first c in s, or s.size() if there is none
+size_t find_char(std::string_view s, char c);
+
+// return the text before the next delimiter and move s past the delimiter
+std::string_view next_token(std::string_view& s, char delimiter);
+
+// return the next line without its line ending and move s to the line after it
+std::string_view next_line(std::string_view& s);
+
+// character i of s, or '\0' past the end
+char char_at(std::string_view s, size_t i);
+
+// parse a number at the start of s the same way std::stof and std::stoi do,
+// returns false if there is no number
+bool parse_float(std::string_view s, float& value);
+bool parse_int(std::string_view s, int& value);
\ No newline at end of file
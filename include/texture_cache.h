@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "image_loader.h"
+
+/*
+The texture cache, a directory of cooked textures. A cooked texture is an
+image exactly as it is copied to the staging buffer: flipped, expanded to the
+channels of the slot, with its mip levels and block compressed if the slot
+is. The file is named after its key, a hash of the contents of the source
+image and of how it was cooked, so an image that changes gets a new entry and
+identical images share one.
+
+	CookedTextureHeader
+	CookedTextureLevel[level_count]     offset and size of each level
+	level data                          each level starts at a multiple of
+	                                    COOKED_TEXTURE_ALIGNMENT
+*/
+
+// bump this whenever the layout of the cooked textures or the way they are
+// cooked changes
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+const uint64_t COOKED_TEXTURE_ALIGNMENT = 16;
+
+struct CookedTextureHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t format;
+	uint64_t key;
+	int32_t width;
+	int32_t height;
+	uint32_t num_channels;
+	uint32_t level_count;
+};
+
+struct CookedTextureLevel {
+	uint64_t offset;
+	uint64_t size;
+};
+
+// make sure every image has a cooked texture in the cache directory, on all
+// the cores. The images that are missing are decoded with decode_image and
+// cooked. Sets the cooked path and the block format of the slots, and returns
+// the number of images that were already in the cache.
+int cook_images(std::vector<ImageSlot>& slots, int num_channels, bool srgb, std::string cache_directory);
+
+// copy the cooked texture of a slot to destination, which is laid out like the
+// slot starting at its offset. A slot made by image_slot_levels only gets its
+// levels. An image without a cooked texture is decoded.
+void read_image(ImageSlot& slot, int num_channels, bool srgb, char* destination);
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+A CPU encoder for the BC block formats. Images are cut into 4x4 blocks, the
+blocks on the right and bottom edges repeat the last column and row.
+
+	BC1   8 bytes per block, two rgb565 endpoints and 2-bit indices, opaque
+	BC3   16 bytes per block, a BC4 alpha block and a BC1 colour block
+	BC5   16 bytes per block, two BC4 blocks for red and green, used for
+	      normal maps whose z is rebuilt in the shader
+
+The endpoints of a colour block are the extremes of the pixels along their
+principal axis, which is fast and good enough for textures.
+*/
+
+enum BlockFormat {
+	BLOCK_NONE,
+	BLOCK_BC1,
+	BLOCK_BC3,
+	BLOCK_BC5
+};
+
+// bytes per 4x4 block, 0 for BLOCK_NONE
+uint32_t block_bytes(BlockFormat format);
+
+// bytes of a width x height image in a block format
+uint64_t compressed_size(int width, int height, BlockFormat format);
+
+// true if every pixel of the rgba image has an alpha of 255
+bool is_opaque(const unsigned char* rgba, size_t num_pixels);
+
+// compress an rgba image, the blocks are stored row by row
+void compress_image(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* blocks);
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "image_loader.h"
+#include "vertex.h"
+
+/*
+Which mip levels of the textures and normal maps are on the GPU. An image is
+resident from some level down to 1x1, and the residency decides every frame
+which images get finer or coarser levels:
+
+	- every image starts with the levels up to RESIDENCY_FLOOR_SIZE and never
+	  drops below them
+	- the visible meshes request the level their on-screen size needs, the
+	  images that have coarser levels than requested are the backlog
+	- the backlog is streamed in a bounded number of bytes per frame, the
+	  images missing the most levels first
+	- when the budget is full, the least recently used images give back their
+	  finer levels first
+*/
+
+// the largest side of the levels an image starts with and always keeps
+const int RESIDENCY_FLOOR_SIZE = 64;
+
+struct MeshFootprint {
+	/*
+	What tells how sharp the images of a mesh have to be: a bounding sphere
+	in world space, and how many uv units cover one unit of its surface
+	*/
+	glm::vec3 center;
+	float radius;
+	float uv_density;
+};
+
+// the footprint of a mesh with its initial transform, vertices and indices
+// point to the start of its ranges
+MeshFootprint mesh_footprint(const Vertex* vertices, int vertex_count, const uint32_t* indices, int index_count,
+	const glm::mat4& transform);
+MeshFootprint mesh_footprint(const VertexWithTangent* vertices, int vertex_count, const uint32_t* indices, int index_count,
+	const glm::mat4& transform);
+
+struct ResidencyChange {
+	/*
+	An image that gets a new first resident level
+	*/
+	int image;
+	uint32_t level;
+};
+
+class TextureResidency {
+public:
+
+	// the most GPU memory the images may take, and the most bytes streamed in
+	// one frame
+	uint64_t budget;
+	uint64_t upload_limit;
+
+	// what the images take now, and what they would take whole
+	uint64_t resident_bytes;
+	uint64_t whole_bytes;
+
+	// the images that need finer levels than they have after the last update,
+	// and the bytes they are missing
+	int backlog_size;
+	uint64_t backlog_bytes;
+
+	// what the updates did so far
+	int num_streamed_in;
+	int num_evicted;
+	uint64_t bytes_streamed;
+
+	// constructor
+	TextureResidency(uint64_t budget_, uint64_t upload_limit_);
+
+	// add an image planned with its whole mip chain, returns its index
+	int add_image(const ImageSlot& slot, int num_channels);
+
+	// the first level an image starts with and never goes above
+	uint32_t floor_level(int image) const;
+
+	// the first level of an image that is on the GPU
+	uint32_t resident_level(int image) const;
+
+	// start a frame, nothing is requested yet
+	void begin_frame();
+
+	// a visible mesh samples the image with this many texels of level 0 per
+	// pixel on screen
+	void request(int image, float texels_per_pixel);
+
+	// decide which images change this frame. The caller makes the changes and
+	// tells with set_resident.
+	std::vector<ResidencyChange> update();
+
+	// an image now has its levels from level on the GPU, taking size bytes
+	void set_resident(int image, uint32_t level, uint64_t size);
+
+private:
+
+	struct Image {
+		// bytes of the chain from every level down to 1x1
+		std::vector<uint64_t> chain_bytes;
+		uint32_t floor;
+		uint32_t resident;
+		uint64_t resident_size;
+
+		// the finest level requested this frame, and the last frame it was
+		// requested in
+		uint32_t wanted;
+		uint64_t last_used;
+	};
+
+	std::vector<Image> images;
+	uint64_t frame;
+};
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+
+class Timer {
+	/*
+	A wall clock stopwatch for timing the stages of the loaders
+	*/
+public:
+
+	// constructor, starts the timer
+	Timer();
+
+	// milliseconds since the last lap, or since the start, and start a new lap
+	double lap();
+
+	// milliseconds since the start
+	double total();
+
+private:
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point last;
+};
\ No newline at end of file
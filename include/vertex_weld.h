@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class VertexWeldTable {
+	/*
+	Finds the face vertices that share a (position, uv, normal) index triplet.
+	The triplet is packed into a 96-bit key and kept in a flat open-addressing
+	table with linear probing. The table is sized up front and never grows.
+	*/
+public:
+
+	// constructor, room for at most max_vertices different triplets
+	VertexWeldTable(size_t max_vertices);
+
+	// the vertex index of the triplet, or -1 after storing new_index for it
+	int find_or_insert(int pos_index, int uv_index, int nor_index, int new_index);
+
+private:
+
+	struct Slot {
+		uint64_t pos_uv;
+		int32_t nor;
+		int32_t vertex_index;
+	};
+
+	std::vector<Slot> slots;
+	size_t mask;
+};
\ No newline at end of file
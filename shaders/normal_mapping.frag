@@ -1,4 +1,5 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 struct UnattenuatedPointLight {
     vec4 pos;
@@ -37,14 +38,15 @@ layout(set = 0, binding = 1) uniform UniformBufferObject {
     vec3 eye;
 } ubo;
 
-layout(set = 1, binding = 0) uniform sampler2D texSampler;
-
-layout(set = 2, binding = 0) uniform sampler2D norSampler;
+// every texture and normal map of the scene, the textures first
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
 layout(location = 0) in vec3 vertex_pos;
 layout(location = 1) in vec3 vertex_normal;
 layout(location = 2) in vec2 fragTexCoord;
 layout(location = 3) in vec3 vertex_tangent;
+layout(location = 4) flat in uint texture_index;
+layout(location = 5) flat in uint normal_map_index;
 
 layout(location = 0) out vec4 outColor;
 
@@ -73,16 +75,17 @@ void main() {
     // 1.4. Assemble the TBN matrix
     mat3 TBN = mat3(new_tangent, new_bitangent, new_normal);
 
-    // 2. Get the normal vector in tangent space from the normal map
-    vec3 normal_tangent_space = texture(norSampler, fragTexCoord).rgb;
+    // 2. Get x and y of the normal vector in tangent space from the normal map and convert them from [0:1] to [-1:1],
+    // the map may be BC5 compressed which only keeps the red and green channels
+    vec2 normal_xy = texture(textures[nonuniformEXT(normal_map_index)], fragTexCoord).rg * 2 - 1;
 
-    // 3. Convert the normal vector in 2. from [0:1] to [-1:1]
-    normal_tangent_space = normal_tangent_space * 2 - 1;
+    // 3. Reconstruct z from the unit length of the normal vector, it always points out of the surface
+    vec3 normal_tangent_space = vec3(normal_xy, sqrt(clamp(1 - dot(normal_xy, normal_xy), 0.0, 1.0)));
 
     // 4. Transform the normal vector from tangent space to the world space using the TBN matrix
     vec3 normal_world = TBN * normal_tangent_space;
 
-    vec4 texture_color = texture(texSampler, fragTexCoord);
+    vec4 texture_color = texture(textures[nonuniformEXT(texture_index)], fragTexCoord);
     vec3 cool = vec3(0.0, 0.0, 0.1) + 0.5 * texture_color.rgb;
     vec3 warm = vec3(0.1, 0.1, 0.0) + 0.5 * texture_color.rgb;
     vec3 v = normalize(ubo.eye - vertex_pos);
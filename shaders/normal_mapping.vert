@@ -5,9 +5,17 @@ layout(set = 0, binding = 0) uniform ViewProjection {
     mat4 proj;
 } vp;
 
-layout(set = 3, binding = 0) uniform Model {
+// the model matrix and the images of every draw, each draw finds its own
+// through its instance index
+struct DrawData {
     mat4 model;
-} model_matrix;
+    uint texture_index;
+    uint normal_map_index;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+} draw_data;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -18,13 +26,18 @@ layout(location = 0) out vec3 vertex_pos;
 layout(location = 1) out vec3 vertex_normal;
 layout(location = 2) out vec2 fragTexCoord;
 layout(location = 3) out vec3 vertex_tangent;
+layout(location = 4) flat out uint texture_index;
+layout(location = 5) flat out uint normal_map_index;
 
 void main() {
+    DrawData draw = draw_data.draws[gl_InstanceIndex];
     
     // calculate vertex position in the clip space
-    gl_Position = vp.proj * vp.view * model_matrix.model * vec4(inPosition, 1.0);
-    vertex_pos = (model_matrix.model * vec4(inPosition, 1.0)).xyz;
-    vertex_normal = mat3(model_matrix.model) * inNormal;
+    gl_Position = vp.proj * vp.view * draw.model * vec4(inPosition, 1.0);
+    vertex_pos = (draw.model * vec4(inPosition, 1.0)).xyz;
+    vertex_normal = mat3(draw.model) * inNormal;
     fragTexCoord = inTexCoord;
-    vertex_tangent = (model_matrix.model * vec4(inTangent, 1.0)).xyz;
+    vertex_tangent = (draw.model * vec4(inTangent, 1.0)).xyz;
+    texture_index = draw.texture_index;
+    normal_map_index = draw.normal_map_index;
 }
\ No newline at end of file
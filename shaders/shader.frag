@@ -1,4 +1,5 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 struct UnattenuatedPointLight {
     vec4 pos;
@@ -37,11 +38,13 @@ layout(set = 0, binding = 1) uniform UniformBufferObject {
     vec3 eye;
 } ubo;
 
-layout(set = 1, binding = 0) uniform sampler2D texSampler;
+// every texture and normal map of the scene, the textures first
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
 layout(location = 0) in vec3 vertex_pos;
 layout(location = 1) in vec3 vertex_normal;
 layout(location = 2) in vec2 fragTexCoord;
+layout(location = 3) flat in uint texture_index;
 
 layout(location = 0) out vec4 outColor;
 
@@ -108,7 +111,7 @@ vec3 cal_spot_light(SpotLight light, vec3 diffuse_color, vec3 n, vec3 v) {
 void main() {
     
     // read the texture
-    vec4 texture_color = texture(texSampler, fragTexCoord);
+    vec4 texture_color = texture(textures[nonuniformEXT(texture_index)], fragTexCoord);
 
     vec3 n = normalize(vertex_normal);
     vec3 v = normalize(ubo.eye - vertex_pos);
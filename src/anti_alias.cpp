@@ -39,14 +39,14 @@ void MSAA::setSampleCount(VkSampleCountFlagBits sample_count) {
 }
 
 void MSAA::createColorResources(VkFormat swapChainImageFormat, VkExtent2D swapChainExtent) {
-	gpu->createImage(swapChainExtent.width, swapChainExtent.height, msaaSamples, swapChainImageFormat,
+	gpu->createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, swapChainImageFormat,
 		VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, colorImage);
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(gpu->logical_gpu, colorImage, &memRequirements);
 
 	gpu->allocateMemory(memRequirements.size, gpu->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), colorImageMemory);
 	vkBindImageMemory(gpu->logical_gpu, colorImage, colorImageMemory, 0);
-	colorImageView = gpu->createImageView(colorImage, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+	colorImageView = gpu->createImageView(colorImage, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 }
 
 VkImageView MSAA::getColorImageView() {
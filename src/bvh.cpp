@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <cmath>
+
+#include "bvh.h"
+#include "parallel.h"
+
+// bin the nodes with at least this many boxes on all the cores
+static const uint32_t PARALLEL_BIN_SIZE = 1 << 16;
+
+// with parallel builds, the top levels are split until the subtrees are
+// about this share of the boxes, then the subtrees are built on all the cores
+static const uint32_t SUBTREES_PER_WORKER = 4;
+
+struct BuildTask {
+	uint32_t node;
+	uint32_t begin;
+	uint32_t end;
+	uint32_t depth;
+};
+
+struct BuildItem {
+	/*
+	A box and its centroid, kept in the order of the leaves while building so
+	the ranges of the nodes are read front to back
+	*/
+	BvhBox box;
+	glm::vec3 centroid;
+	uint32_t index;
+};
+
+struct Bins {
+	BvhBox bounds[3][BVH_BINS];
+	uint32_t counts[3][BVH_BINS];
+};
+
+Ray::Ray(glm::vec3 origin_, glm::vec3 direction_) {
+	origin = origin_;
+	direction = direction_;
+	inverse_direction = glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+}
+
+static BvhBox empty_box() {
+	return { glm::vec3(INFINITY), glm::vec3(-INFINITY) };
+}
+
+static void grow(BvhBox& box, const BvhBox& other) {
+	box.low = glm::min(box.low, other.low);
+	box.high = glm::max(box.high, other.high);
+}
+
+static void grow(BvhBox& box, glm::vec3 point) {
+	box.low = glm::min(box.low, point);
+	box.high = glm::max(box.high, point);
+}
+
+static float half_area(const BvhBox& box) {
+	glm::vec3 size = box.high - box.low;
+	if (size.x < 0.0f) return 0.0f;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+static int piece_count(uint32_t begin, uint32_t end, bool parallel) {
+	return parallel && end - begin >= PARALLEL_BIN_SIZE ? get_num_workers() : 1;
+}
+
+template <typename Work>
+static void for_pieces(uint32_t begin, uint32_t end, int pieces, Work work) {
+	/*
+	Run work(piece, first, last) over pieces of a range, on all the cores
+	when there is more than one piece
+	*/
+	auto run = [&](int piece) {
+		uint32_t first = begin + uint64_t(end - begin) * piece / pieces;
+		uint32_t last = begin + uint64_t(end - begin) * (piece + 1) / pieces;
+		work(piece, first, last);
+	};
+	if (pieces == 1) run(0);
+	else parallel_for(pieces, run);
+}
+
+static void range_bounds(const std::vector<BuildItem>& items, uint32_t begin, uint32_t end, bool parallel,
+	BvhBox& bounds, BvhBox& centroid_bounds) {
+	auto accumulate = [&](uint32_t first, uint32_t last, BvhBox& piece_bounds, BvhBox& piece_centroids) {
+		piece_bounds = empty_box();
+		piece_centroids = empty_box();
+		for (uint32_t i = first; i < last; i++) {
+			grow(piece_bounds, items[i].box);
+			grow(piece_centroids, items[i].centroid);
+		}
+	};
+	int pieces = piece_count(begin, end, parallel);
+	if (pieces == 1) {
+		accumulate(begin, end, bounds, centroid_bounds);
+		return;
+	}
+
+	std::vector<BvhBox> piece_bounds(pieces);
+	std::vector<BvhBox> piece_centroids(pieces);
+	for_pieces(begin, end, pieces, [&](int piece, uint32_t first, uint32_t last) {
+		accumulate(first, last, piece_bounds[piece], piece_centroids[piece]);
+	});
+	bounds = empty_box();
+	centroid_bounds = empty_box();
+	for (int piece = 0; piece < pieces; piece++) {
+		grow(bounds, piece_bounds[piece]);
+		grow(centroid_bounds, piece_centroids[piece]);
+	}
+}
+
+static int bin_of(float centroid, float low, float scale, int bin_count) {
+	return std::min(bin_count - 1, int((centroid - low) * scale));
+}
+
+static void bin_range(const std::vector<BuildItem>& items, uint32_t begin, uint32_t end, bool parallel,
+	const BvhBox& centroid_bounds, const glm::vec3& scale, int bin_count, Bins& bins) {
+	auto accumulate = [&](uint32_t first, uint32_t last, Bins& piece_bins) {
+		for (int axis = 0; axis < 3; axis++) {
+			for (int bin = 0; bin < bin_count; bin++) {
+				piece_bins.bounds[axis][bin] = empty_box();
+				piece_bins.counts[axis][bin] = 0;
+			}
+		}
+		for (uint32_t i = first; i < last; i++) {
+			for (int axis = 0; axis < 3; axis++) {
+				int bin = bin_of(items[i].centroid[axis], centroid_bounds.low[axis], scale[axis], bin_count);
+				grow(piece_bins.bounds[axis][bin], items[i].box);
+				piece_bins.counts[axis][bin]++;
+			}
+		}
+	};
+	int pieces = piece_count(begin, end, parallel);
+	if (pieces == 1) {
+		accumulate(begin, end, bins);
+		return;
+	}
+
+	std::vector<Bins> piece_bins(pieces);
+	for_pieces(begin, end, pieces, [&](int piece, uint32_t first, uint32_t last) {
+		accumulate(first, last, piece_bins[piece]);
+	});
+	bins = piece_bins[0];
+	for (int piece = 1; piece < pieces; piece++) {
+		for (int axis = 0; axis < 3; axis++) {
+			for (int bin = 0; bin < bin_count; bin++) {
+				grow(bins.bounds[axis][bin], piece_bins[piece].bounds[axis][bin]);
+				bins.counts[axis][bin] += piece_bins[piece].counts[axis][bin];
+			}
+		}
+	}
+}
+
+static bool split_node(std::vector<BuildItem>& items, BvhNode& node, uint32_t begin, uint32_t end, uint32_t depth,
+	bool parallel, uint32_t& middle) {
+	/*
+	Set the box of a node and split its boxes in two ranges at the cheapest
+	bin boundary, false if the node stays a leaf
+	*/
+	BvhBox bounds, centroid_bounds;
+	range_bounds(items, begin, end, parallel, bounds, centroid_bounds);
+	node.aabb_min = bounds.low;
+	node.aabb_max = bounds.high;
+	node.first = begin;
+	node.count = end - begin;
+	if (node.count <= 1 || depth + 1 >= BVH_MAX_DEPTH) return false;
+
+	// the axes the centroids are spread along, small nodes use fewer bins
+	int bin_count = std::min(uint32_t(BVH_BINS), node.count);
+	glm::vec3 extent = centroid_bounds.high - centroid_bounds.low;
+	glm::vec3 scale(0.0f);
+	for (int axis = 0; axis < 3; axis++) {
+		if (extent[axis] > 0.0f) scale[axis] = bin_count / extent[axis];
+	}
+	Bins bins;
+	bin_range(items, begin, end, parallel, centroid_bounds, scale, bin_count, bins);
+
+	// sweep the bins from the right for the boxes right of every boundary,
+	// then from the left for the cheapest boundary
+	float best_cost = INFINITY;
+	int best_axis = -1;
+	int best_bin = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		if (scale[axis] == 0.0f) continue;
+		float right_area[BVH_BINS];
+		uint32_t right_count[BVH_BINS];
+		BvhBox right = empty_box();
+		uint32_t count = 0;
+		for (int bin = bin_count - 1; bin > 0; bin--) {
+			grow(right, bins.bounds[axis][bin]);
+			count += bins.counts[axis][bin];
+			right_area[bin] = half_area(right);
+			right_count[bin] = count;
+		}
+		BvhBox left = empty_box();
+		count = 0;
+		for (int bin = 0; bin < bin_count - 1; bin++) {
+			grow(left, bins.bounds[axis][bin]);
+			count += bins.counts[axis][bin];
+			if (count == 0 || right_count[bin + 1] == 0) continue;
+			float cost = count * half_area(left) + right_count[bin + 1] * right_area[bin + 1];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = bin + 1;
+			}
+		}
+	}
+
+	// a leaf when splitting doesn't pay off, unless it is too large
+	float area = half_area(bounds);
+	bool worth_it = best_axis != -1 && (area == 0.0f || 1.0f + best_cost / area < node.count);
+	if (!worth_it && node.count <= BVH_MAX_LEAF_SIZE) return false;
+
+	if (best_axis != -1) {
+		float low = centroid_bounds.low[best_axis];
+		float axis_scale = scale[best_axis];
+		middle = std::partition(items.begin() + begin, items.begin() + end, [&](const BuildItem& item) {
+			return bin_of(item.centroid[best_axis], low, axis_scale, bin_count) < best_bin;
+		}) - items.begin();
+	}
+
+	// all the centroids in one place, any halves do
+	if (best_axis == -1 || middle == begin || middle == end) middle = begin + (end - begin) / 2;
+	return true;
+}
+
+static void build_nodes(std::vector<BuildItem>& items, std::vector<BvhNode>& nodes, BuildTask root, bool parallel,
+	uint32_t defer_size, std::vector<BuildTask>* deferred) {
+	/*
+	Build the subtree of a task, its node is already in nodes. With deferred,
+	the ranges of at most defer_size boxes are left for later.
+	*/
+	std::vector<BuildTask> stack = { root };
+	while (!stack.empty()) {
+		BuildTask task = stack.back();
+		stack.pop_back();
+		if (deferred != nullptr && task.end - task.begin <= defer_size) {
+			deferred->push_back(task);
+			continue;
+		}
+
+		uint32_t middle;
+		BvhNode node;
+		bool split = split_node(items, node, task.begin, task.end, task.depth, parallel, middle);
+		if (split) {
+			node.first = nodes.size();
+			node.count = 0;
+			nodes.resize(nodes.size() + 2);
+			stack.push_back({ node.first + 1, middle, task.end, task.depth + 1 });
+			stack.push_back({ node.first, task.begin, middle, task.depth + 1 });
+		}
+		nodes[task.node] = node;
+	}
+}
+
+static void build_in_parallel(std::vector<BuildItem>& items, std::vector<BvhNode>& nodes) {
+	/*
+	Split the top levels with their boxes binned on all the cores, then build
+	the subtrees below them on all the cores and move them behind the top
+	levels
+	*/
+	std::vector<BuildTask> deferred;
+	uint32_t box_count = items.size();
+	uint32_t defer_size = box_count / (SUBTREES_PER_WORKER * get_num_workers());
+	build_nodes(items, nodes, { 0, 0, box_count, 0 }, true, defer_size, &deferred);
+
+	// every subtree is built with its root at 0 of its own nodes
+	std::vector<std::vector<BvhNode>> subtrees(deferred.size());
+	parallel_for(deferred.size(), [&](int i) {
+		BuildTask task = deferred[i];
+		subtrees[i].reserve(2 * (task.end - task.begin));
+		subtrees[i].resize(1);
+		task.node = 0;
+		build_nodes(items, subtrees[i], task, false, 0, nullptr);
+	});
+
+	// the root of a subtree takes the place of its task, the rest go behind
+	// the nodes so far
+	for (size_t i = 0; i < subtrees.size(); i++) {
+		uint32_t base = nodes.size() - 1;
+		for (size_t j = 0; j < subtrees[i].size(); j++) {
+			BvhNode node = subtrees[i][j];
+			if (node.count == 0) node.first += base;
+			if (j == 0) nodes[deferred[i].node] = node;
+			else nodes.push_back(node);
+		}
+	}
+}
+
+Bvh build_bvh(const std::vector<BvhBox>& boxes, bool parallel) {
+	/*
+	Without parallel the whole tree is built on the calling thread
+	*/
+	Bvh bvh;
+	if (boxes.empty()) return bvh;
+
+	uint32_t box_count = boxes.size();
+	std::vector<BuildItem> items(box_count);
+	for_pieces(0, box_count, piece_count(0, box_count, parallel), [&](int /*piece*/, uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) items[i] = { boxes[i], (boxes[i].low + boxes[i].high) * 0.5f, i };
+	});
+
+	bvh.nodes.reserve(2 * box_count);
+	bvh.nodes.resize(1);
+	if (!parallel) {
+		build_nodes(items, bvh.nodes, { 0, 0, box_count, 0 }, false, 0, nullptr);
+	} else {
+		build_in_parallel(items, bvh.nodes);
+	}
+
+	// the boxes in the order they were partitioned into
+	bvh.indices.resize(box_count);
+	for_pieces(0, box_count, piece_count(0, box_count, parallel), [&](int /*piece*/, uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) bvh.indices[i] = items[i].index;
+	});
+	return bvh;
+}
+
+std::vector<BvhBox> triangle_boxes(const TriangleMesh& mesh) {
+	std::vector<BvhBox> boxes(mesh.triangle_count);
+	for (uint32_t i = 0; i < mesh.triangle_count; i++) {
+		BvhBox box = empty_box();
+		for (int k = 0; k < 3; k++) grow(box, mesh.position(mesh.indices[3 * i + k]));
+		boxes[i] = box;
+	}
+	return boxes;
+}
+
+bool valid_bvh(const Bvh& bvh, uint32_t primitive_count) {
+	/*
+	The children come after their parent, so a pass in order sees every
+	parent before its children and the tree has no cycles. Every node but
+	the root has exactly one parent, so the depth of a node is the length of
+	its only path from the root.
+	*/
+	if (bvh.nodes.empty()) return bvh.indices.empty();
+	for (uint32_t index : bvh.indices) {
+		if (index >= primitive_count) return false;
+	}
+	std::vector<uint32_t> depth(bvh.nodes.size(), 0);
+	std::vector<uint8_t> linked(bvh.nodes.size(), 0);
+	linked[0] = 1;
+	for (size_t i = 0; i < bvh.nodes.size(); i++) {
+		const BvhNode& node = bvh.nodes[i];
+		if (!linked[i] || depth[i] >= BVH_MAX_DEPTH) return false;
+		if (node.count > 0) {
+			if (node.first > bvh.indices.size() || node.count > bvh.indices.size() - node.first) return false;
+		} else {
+			if (node.first <= i || node.first >= bvh.nodes.size() - 1) return false;
+			if (linked[node.first] || linked[node.first + 1]) return false;
+			linked[node.first] = 1;
+			linked[node.first + 1] = 1;
+			depth[node.first] = depth[i] + 1;
+			depth[node.first + 1] = depth[i] + 1;
+		}
+	}
+	return true;
+}
+
+bool intersect_triangle(const Ray& ray, glm::vec3 a, glm::vec3 b, glm::vec3 c, float t_max, float& t) {
+	/*
+	Möller-Trumbore: solve for the distance and the barycentrics of the hit
+	with the plane of the triangle, both sides of the triangle are hit
+	*/
+	glm::vec3 edge_1 = b - a;
+	glm::vec3 edge_2 = c - a;
+	glm::vec3 p = glm::cross(ray.direction, edge_2);
+	float determinant = glm::dot(edge_1, p);
+	if (std::abs(determinant) < 1e-12f) return false;
+	float inverse_determinant = 1.0f / determinant;
+	glm::vec3 s = ray.origin - a;
+	float u = glm::dot(s, p) * inverse_determinant;
+	if (u < 0.0f || u > 1.0f) return false;
+	glm::vec3 q = glm::cross(s, edge_1);
+	float v = glm::dot(ray.direction, q) * inverse_determinant;
+	if (v < 0.0f || u + v > 1.0f) return false;
+	t = glm::dot(edge_2, q) * inverse_determinant;
+	return t > 0.0f && t < t_max;
+}
+
+bool intersect_triangles(const Bvh& bvh, const TriangleMesh& mesh, const Ray& ray, float& t_max, uint32_t& triangle) {
+	bool hit = false;
+	traverse_bvh(bvh, ray, t_max, [&](uint32_t i, float& t_nearest) {
+		float t;
+		const uint32_t* corners = mesh.indices + 3 * i;
+		if (intersect_triangle(ray, mesh.position(corners[0]), mesh.position(corners[1]), mesh.position(corners[2]),
+			t_nearest, t)) {
+			t_nearest = t;
+			triangle = i;
+			hit = true;
+		}
+	});
+	return hit;
+}
\ No newline at end of file
@@ -42,14 +42,19 @@ void Camera::awsd_movement(GLFWwindow* window) {
 	float deltaTime = currentFrame - last_frame;
 	last_frame = currentFrame;
 	float cameraSpeed = 2.5f * deltaTime;
+	glm::vec3 target = cameraPos;
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		cameraPos += cameraSpeed * cameraFront;
+		target += cameraSpeed * cameraFront;
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		cameraPos -= cameraSpeed * cameraFront;
+		target -= cameraSpeed * cameraFront;
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		cameraPos -= normalize(cross(cameraFront, cameraUp)) * cameraSpeed;
+		target -= normalize(cross(cameraFront, cameraUp)) * cameraSpeed;
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		cameraPos += normalize(cross(cameraFront, cameraUp)) * cameraSpeed;
+		target += normalize(cross(cameraFront, cameraUp)) * cameraSpeed;
+
+	// stop at what is in the way
+	if (target == cameraPos) return;
+	cameraPos = collide ? collide(cameraPos, target) : target;
 }
 
 void Camera::mouse_callback(double xpos, double ypos) {
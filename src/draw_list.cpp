@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cstring>
+
+#include "draw_list.h"
+
+uint64_t draw_key(DrawPipeline pipeline, uint32_t texture_index, float depth) {
+	uint32_t depth_bits;
+	depth = std::max(depth, 0.0f);
+	memcpy(&depth_bits, &depth, sizeof(depth_bits));
+	return (uint64_t(pipeline) << 60) | (uint64_t(texture_index & 0x0fffffff) << 32) | depth_bits;
+}
+
+static Draw make_draw(const MeshBase& mesh, uint32_t mesh_index) {
+	Draw draw;
+	draw.pipeline = DRAW_PIPELINE_BASIC;
+	draw.with_normal_map = false;
+	draw.texture_index = mesh.texture_index;
+	draw.normal_map_index = 0;
+	draw.model = mesh.init_transform;
+	draw.index_count = mesh.index_count;
+	draw.index_offset = mesh.index_offset;
+	draw.vertex_offset = mesh.vertex_offset;
+	draw.bounds = mesh.bounds;
+	draw.mesh = mesh_index;
+	return draw;
+}
+
+void DrawList::build(const Scene& scene) {
+	/*
+	The meshes without a texture are never drawn. The draws are grouped by
+	whether they have a normal map and by texture, so the sort of every frame
+	starts from nearly sorted draws.
+	*/
+	draws.clear();
+	for (int i = 0; i < scene.meshes.size(); i++) {
+		const Mesh& mesh = scene.meshes[i];
+		if (mesh.texture_index < 0 || mesh.texture_index >= scene.textures.size()) continue;
+		draws.push_back(make_draw(mesh, i));
+	}
+	for (int i = 0; i < scene.meshes_with_normal_map.size(); i++) {
+		const MeshWithNormalMap& mesh = scene.meshes_with_normal_map[i];
+		if (mesh.texture_index < 0 || mesh.texture_index >= scene.textures.size()) continue;
+		Draw draw = make_draw(mesh, scene.meshes.size() + i);
+		draw.with_normal_map = true;
+		draw.normal_map_index = scene.textures.size() + mesh.normal_map_index;
+		draws.push_back(draw);
+	}
+	std::stable_sort(draws.begin(), draws.end(), [](const Draw& a, const Draw& b) {
+		if (a.with_normal_map != b.with_normal_map) return b.with_normal_map;
+		return a.texture_index < b.texture_index;
+	});
+
+	num_buckets = 0;
+	first_with_normal_map = draws.size();
+	for (size_t i = 0; i < draws.size(); i++) {
+		if (i == 0 || draws[i].with_normal_map != draws[i - 1].with_normal_map ||
+			draws[i].texture_index != draws[i - 1].texture_index) num_buckets++;
+		if (draws[i].with_normal_map) first_with_normal_map = std::min(first_with_normal_map, uint32_t(i));
+	}
+
+	order.resize(draws.size());
+	for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+	keys.resize(draws.size());
+}
+
+void DrawList::sort(glm::vec3 eye, glm::vec3 forward, bool normal_mapping) {
+	DrawPipeline with_normal_map = normal_mapping ? DRAW_PIPELINE_NORMAL_MAPPING : DRAW_PIPELINE_BASIC_T;
+	for (uint32_t i = 0; i < draws.size(); i++) {
+		Draw& draw = draws[i];
+		draw.pipeline = draw.with_normal_map ? with_normal_map : DRAW_PIPELINE_BASIC;
+		keys[i] = { draw_key(draw.pipeline, draw.texture_index, glm::dot(draw.bounds.center - eye, forward)), i };
+	}
+	std::sort(keys.begin(), keys.end());
+	for (size_t i = 0; i < keys.size(); i++) order[i] = keys[i].second;
+}
+
+std::vector<DrawData> DrawList::draw_data() const {
+	std::vector<DrawData> data(draws.size());
+	for (size_t i = 0; i < draws.size(); i++) {
+		data[i].model = draws[i].model;
+		data[i].texture_index = draws[i].texture_index;
+		data[i].normal_map_index = draws[i].normal_map_index;
+		data[i].padding[0] = 0;
+		data[i].padding[1] = 0;
+	}
+	return data;
+}
+
+std::vector<VkDrawIndexedIndirectCommand> DrawList::indirect_commands() const {
+	std::vector<VkDrawIndexedIndirectCommand> commands(draws.size());
+	for (uint32_t i = 0; i < draws.size(); i++) {
+		commands[i].indexCount = draws[i].index_count;
+		commands[i].instanceCount = 1;
+		commands[i].firstIndex = draws[i].index_offset;
+		commands[i].vertexOffset = draws[i].vertex_offset;
+		commands[i].firstInstance = i;
+	}
+	return commands;
+}
+
+std::vector<MeshBounds> DrawList::bounds() const {
+	std::vector<MeshBounds> result(draws.size());
+	for (size_t i = 0; i < draws.size(); i++) result[i] = draws[i].bounds;
+	return result;
+}
\ No newline at end of file
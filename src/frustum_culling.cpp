@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "frustum_culling.h"
+#include "sm_math.h"
+
+template <typename VertexType>
+static MeshBounds bounds_of(const VertexType* vertices, int vertex_count, const glm::mat4& transform) {
+	MeshBounds bounds = { glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+	if (vertex_count == 0) return bounds;
+
+	bounds.aabb_min = glm::vec3(INFINITY);
+	bounds.aabb_max = glm::vec3(-INFINITY);
+	for (int i = 0; i < vertex_count; i++) {
+		glm::vec3 position = glm::vec3(transform * glm::vec4(vertices[i].pos, 1.0f));
+		bounds.aabb_min = glm::min(bounds.aabb_min, position);
+		bounds.aabb_max = glm::max(bounds.aabb_max, position);
+	}
+	bounds.center = (bounds.aabb_min + bounds.aabb_max) * 0.5f;
+	for (int i = 0; i < vertex_count; i++) {
+		glm::vec3 position = glm::vec3(transform * glm::vec4(vertices[i].pos, 1.0f));
+		bounds.radius = std::max(bounds.radius, glm::length(position - bounds.center));
+	}
+	return bounds;
+}
+
+MeshBounds mesh_bounds(const Vertex* vertices, int vertex_count, const glm::mat4& transform) {
+	return bounds_of(vertices, vertex_count, transform);
+}
+
+MeshBounds mesh_bounds(const VertexWithTangent* vertices, int vertex_count, const glm::mat4& transform) {
+	return bounds_of(vertices, vertex_count, transform);
+}
+
+FrustumCuller::FrustumCuller() {
+	num_tested = 0;
+	num_culled = 0;
+	count = 0;
+}
+
+void FrustumCuller::setBounds(const std::vector<MeshBounds>& bounds) {
+	/*
+	The padding boxes are tested with the others and dropped from the result
+	*/
+	count = bounds.size();
+	size_t padded = (bounds.size() + 7) / 8 * 8;
+	for (std::vector<float>* array : { &center_x, &center_y, &center_z, &extent_x, &extent_y, &extent_z }) {
+		array->assign(padded, 0.0f);
+	}
+	for (size_t i = 0; i < bounds.size(); i++) {
+		glm::vec3 center = (bounds[i].aabb_min + bounds[i].aabb_max) * 0.5f;
+		glm::vec3 extent = (bounds[i].aabb_max - bounds[i].aabb_min) * 0.5f;
+		center_x[i] = center.x;
+		center_y[i] = center.y;
+		center_z[i] = center.z;
+		extent_x[i] = extent.x;
+		extent_y[i] = extent.y;
+		extent_z[i] = extent.z;
+	}
+}
+
+void FrustumCuller::cull(const glm::mat4& view_projection, std::vector<uint8_t>& visible) {
+	glm::vec4 planes[6];
+	frustum_planes(view_projection, planes);
+	visible.resize(center_x.size());
+
+	for (size_t first = 0; first < center_x.size(); first += 8) {
+#if defined(__AVX__)
+		__m256 cx = _mm256_loadu_ps(&center_x[first]);
+		__m256 cy = _mm256_loadu_ps(&center_y[first]);
+		__m256 cz = _mm256_loadu_ps(&center_z[first]);
+		__m256 ex = _mm256_loadu_ps(&extent_x[first]);
+		__m256 ey = _mm256_loadu_ps(&extent_y[first]);
+		__m256 ez = _mm256_loadu_ps(&extent_z[first]);
+		__m256 outside = _mm256_setzero_ps();
+		for (const glm::vec4& plane : planes) {
+			__m256 distance = _mm256_set1_ps(plane.w);
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(cx, _mm256_set1_ps(plane.x)));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(cy, _mm256_set1_ps(plane.y)));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(cz, _mm256_set1_ps(plane.z)));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(ex, _mm256_set1_ps(std::abs(plane.x))));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(ey, _mm256_set1_ps(std::abs(plane.y))));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(ez, _mm256_set1_ps(std::abs(plane.z))));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+		int mask = _mm256_movemask_ps(outside);
+#elif defined(__SSE2__) || defined(_M_X64)
+		int mask = 0;
+		for (size_t half = 0; half < 8; half += 4) {
+			__m128 cx = _mm_loadu_ps(&center_x[first + half]);
+			__m128 cy = _mm_loadu_ps(&center_y[first + half]);
+			__m128 cz = _mm_loadu_ps(&center_z[first + half]);
+			__m128 ex = _mm_loadu_ps(&extent_x[first + half]);
+			__m128 ey = _mm_loadu_ps(&extent_y[first + half]);
+			__m128 ez = _mm_loadu_ps(&extent_z[first + half]);
+			__m128 outside = _mm_setzero_ps();
+			for (const glm::vec4& plane : planes) {
+				__m128 distance = _mm_set1_ps(plane.w);
+				distance = _mm_add_ps(distance, _mm_mul_ps(cx, _mm_set1_ps(plane.x)));
+				distance = _mm_add_ps(distance, _mm_mul_ps(cy, _mm_set1_ps(plane.y)));
+				distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(plane.z)));
+				distance = _mm_add_ps(distance, _mm_mul_ps(ex, _mm_set1_ps(std::abs(plane.x))));
+				distance = _mm_add_ps(distance, _mm_mul_ps(ey, _mm_set1_ps(std::abs(plane.y))));
+				distance = _mm_add_ps(distance, _mm_mul_ps(ez, _mm_set1_ps(std::abs(plane.z))));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+			}
+			mask |= _mm_movemask_ps(outside) << half;
+		}
+#else
+		int mask = 0;
+		for (size_t lane = 0; lane < 8; lane++) {
+			size_t i = first + lane;
+			for (const glm::vec4& plane : planes) {
+				float distance = plane.w + center_x[i] * plane.x + center_y[i] * plane.y + center_z[i] * plane.z +
+					extent_x[i] * std::abs(plane.x) + extent_y[i] * std::abs(plane.y) + extent_z[i] * std::abs(plane.z);
+				if (distance < 0.0f) mask |= 1 << lane;
+			}
+		}
+#endif
+		for (size_t lane = 0; lane < 8; lane++) visible[first + lane] = (mask >> lane & 1) ? 0 : 1;
+	}
+
+	visible.resize(count);
+	num_tested = count;
+	num_culled = count - std::count(visible.begin(), visible.end(), uint8_t(1));
+}
+
+float FrustumCuller::culledPercent() const {
+	return num_tested == 0 ? 0.0f : 100.0f * num_culled / num_tested;
+}
\ No newline at end of file
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SM_CODEC_SSSE3 __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define SM_CODEC_SSSE3
+#include <intrin.h>
+#include <tmmintrin.h>
+#endif
+
+#include "geometry_codec.h"
+#include "parallel.h"
+
+static const int BASE_CHANNELS = 7;
+static const int TANGENT_CHANNELS = 3;
+
+struct BlockBounds {
+	/*
+	The quantization of the positions of a vertex block
+	*/
+	float min[3];
+	float scale[3];
+};
+
+static uint32_t zigzag(uint32_t delta) {
+	return (delta << 1) ^ (0u - (delta >> 31));
+}
+
+static uint32_t unzigzag(uint32_t value) {
+	return (value >> 1) ^ (0u - (value & 1));
+}
+
+static uint32_t float_bits(float f) {
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(float));
+	return bits;
+}
+
+static float bits_float(uint32_t bits) {
+	float f;
+	memcpy(&f, &bits, sizeof(float));
+	return f;
+}
+
+static void oct_encode(glm::vec3 n, uint32_t& x, uint32_t& y) {
+	/*
+	Project the normal on an octahedron and unfold the lower half, a zero
+	normal comes back as (0, 0, 1)
+	*/
+	float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	float u = sum > 0.0f ? n.x / sum : 0.0f;
+	float v = sum > 0.0f ? n.y / sum : 0.0f;
+	if (n.z < 0.0f) {
+		float folded_u = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		float folded_v = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+		u = folded_u;
+		v = folded_v;
+	}
+	x = uint32_t(int32_t(std::lround(std::min(std::max(u, -1.0f), 1.0f) * 32767.0f)));
+	y = uint32_t(int32_t(std::lround(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f)));
+}
+
+static glm::vec3 oct_decode(uint32_t x, uint32_t y) {
+	float u = int32_t(x) / 32767.0f;
+	float v = int32_t(y) / 32767.0f;
+	glm::vec3 n(u, v, 1.0f - std::fabs(u) - std::fabs(v));
+	if (n.z < 0.0f) {
+		n.x = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		n.y = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+	}
+	return n / std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+}
+
+static int channel_count(const Vertex*) {
+	return BASE_CHANNELS;
+}
+
+static int channel_count(const VertexWithTangent*) {
+	return BASE_CHANNELS + TANGENT_CHANNELS;
+}
+
+static void gather_extra_channels(const Vertex&, uint32_t*, size_t, size_t) {}
+
+static void gather_extra_channels(const VertexWithTangent& vertex, uint32_t* channels, size_t n, size_t i) {
+	for (int k = 0; k < 3; k++) channels[(BASE_CHANNELS + k) * n + i] = float_bits(vertex.tangent[k]);
+}
+
+static void scatter_extra_channels(Vertex&, const uint32_t*, size_t, size_t) {}
+
+static void scatter_extra_channels(VertexWithTangent& vertex, const uint32_t* channels, size_t n, size_t i) {
+	for (int k = 0; k < 3; k++) vertex.tangent[k] = bits_float(channels[(BASE_CHANNELS + k) * n + i]);
+}
+
+/*
+Stream vbyte
+*/
+
+static void stream_vbyte_encode(const uint32_t* values, size_t count, std::vector<char>& out) {
+	size_t control = out.size();
+	out.resize(control + (count + 3) / 4, 0);
+	for (size_t i = 0; i < count; i++) {
+		uint32_t value = values[i];
+		int length = value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4;
+		out[control + i / 4] |= char((length - 1) << ((i % 4) * 2));
+		for (int b = 0; b < length; b++) out.push_back(char(value >> (8 * b)));
+	}
+}
+
+#ifdef SM_CODEC_SSSE3
+struct ShuffleTables {
+	/*
+	For every control byte, the shuffle that spreads its 4 values to 32 bits
+	and the number of data bytes they take
+	*/
+	alignas(16) uint8_t masks[256][16];
+	uint8_t lengths[256];
+
+	ShuffleTables() {
+		for (int control = 0; control < 256; control++) {
+			int offset = 0;
+			for (int k = 0; k < 4; k++) {
+				int length = ((control >> (2 * k)) & 3) + 1;
+				for (int b = 0; b < 4; b++) masks[control][4 * k + b] = b < length ? uint8_t(offset + b) : 0x80;
+				offset += length;
+			}
+			lengths[control] = uint8_t(offset);
+		}
+	}
+};
+
+static const ShuffleTables shuffle_tables;
+
+static bool cpu_has_ssse3() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 9)) != 0;
+#else
+	return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+static const bool use_ssse3 = cpu_has_ssse3();
+
+SM_CODEC_SSSE3
+static size_t stream_vbyte_decode_ssse3(
+	const uint8_t* control,
+	const uint8_t*& data,
+	const uint8_t* end,
+	size_t count,
+	uint32_t* out
+) {
+	/*
+	Decode 4 values per control byte while a full 16-byte load stays in the
+	stream, the caller decodes the rest
+	*/
+	size_t i = 0;
+	for (; i + 4 <= count && end - data >= 16; i += 4) {
+		uint8_t c = control[i / 4];
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+		__m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle_tables.masks[c]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_shuffle_epi8(bytes, mask));
+		data += shuffle_tables.lengths[c];
+	}
+	return i;
+}
+#endif
+
+static const uint8_t* stream_vbyte_decode(const uint8_t* in, const uint8_t* end, size_t count, uint32_t* out) {
+	/*
+	Returns the end of the values, or nullptr if they don't fit in the stream
+	*/
+	const uint8_t* control = in;
+	if (size_t(end - in) < (count + 3) / 4) return nullptr;
+	const uint8_t* data = in + (count + 3) / 4;
+	size_t i = 0;
+#ifdef SM_CODEC_SSSE3
+	if (use_ssse3) i = stream_vbyte_decode_ssse3(control, data, end, count, out);
+#endif
+	for (; i < count; i++) {
+		int length = ((control[i / 4] >> ((i % 4) * 2)) & 3) + 1;
+		if (end - data < length) return nullptr;
+		uint32_t value = 0;
+		for (int b = 0; b < length; b++) value |= uint32_t(data[b]) << (8 * b);
+		data += length;
+		out[i] = value;
+	}
+	return data;
+}
+
+/*
+Blocks
+*/
+
+static void delta_encode(uint32_t* channel, size_t n) {
+	uint32_t previous = 0;
+	for (size_t i = 0; i < n; i++) {
+		uint32_t value = channel[i];
+		channel[i] = zigzag(value - previous);
+		previous = value;
+	}
+}
+
+static void delta_decode(uint32_t* channel, size_t n) {
+	uint32_t previous = 0;
+	for (size_t i = 0; i < n; i++) {
+		previous += unzigzag(channel[i]);
+		channel[i] = previous;
+	}
+}
+
+template <typename VertexType>
+static void encode_vertex_block(const VertexType* vertices, size_t n, std::vector<char>& out) {
+
+	// quantize the positions inside the bounding box of the block
+	BlockBounds bounds;
+	for (int k = 0; k < 3; k++) {
+		float low = vertices[0].pos[k];
+		float high = vertices[0].pos[k];
+		for (size_t i = 1; i < n; i++) {
+			low = std::min(low, vertices[i].pos[k]);
+			high = std::max(high, vertices[i].pos[k]);
+		}
+		bounds.min[k] = low;
+		bounds.scale[k] = (high - low) / 65535.0f;
+	}
+
+	// split the vertices into channels
+	int num_channels = channel_count(vertices);
+	std::vector<uint32_t> channels(num_channels * n);
+	for (size_t i = 0; i < n; i++) {
+		const VertexType& vertex = vertices[i];
+		for (int k = 0; k < 3; k++) {
+			float q = bounds.scale[k] > 0.0f ? (vertex.pos[k] - bounds.min[k]) / bounds.scale[k] : 0.0f;
+			channels[k * n + i] = uint32_t(std::min(std::max(std::lround(q), 0l), 65535l));
+		}
+		oct_encode(vertex.normal, channels[3 * n + i], channels[4 * n + i]);
+		channels[5 * n + i] = float_bits(vertex.texCoord.x);
+		channels[6 * n + i] = float_bits(vertex.texCoord.y);
+		gather_extra_channels(vertex, channels.data(), n, i);
+	}
+	for (int c = 0; c < num_channels; c++) delta_encode(channels.data() + c * n, n);
+
+	const char* bounds_bytes = reinterpret_cast<const char*>(&bounds);
+	out.insert(out.end(), bounds_bytes, bounds_bytes + sizeof(BlockBounds));
+	stream_vbyte_encode(channels.data(), channels.size(), out);
+}
+
+template <typename VertexType>
+static bool decode_vertex_block(const uint8_t* in, const uint8_t* end, size_t n, VertexType* vertices) {
+	if (size_t(end - in) < sizeof(BlockBounds)) return false;
+	BlockBounds bounds;
+	memcpy(&bounds, in, sizeof(BlockBounds));
+
+	int num_channels = channel_count(vertices);
+	thread_local std::vector<uint32_t> channels;
+	channels.resize(num_channels * n);
+	if (stream_vbyte_decode(in + sizeof(BlockBounds), end, channels.size(), channels.data()) == nullptr) return false;
+	for (int c = 0; c < num_channels; c++) delta_decode(channels.data() + c * n, n);
+
+	for (size_t i = 0; i < n; i++) {
+		VertexType& vertex = vertices[i];
+		for (int k = 0; k < 3; k++) vertex.pos[k] = bounds.min[k] + channels[k * n + i] * bounds.scale[k];
+		vertex.normal = oct_decode(channels[3 * n + i], channels[4 * n + i]);
+		vertex.texCoord.x = bits_float(channels[5 * n + i]);
+		vertex.texCoord.y = bits_float(channels[6 * n + i]);
+		scatter_extra_channels(vertex, channels.data(), n, i);
+	}
+	return true;
+}
+
+static void encode_index_block(const uint32_t* indices, size_t n, std::vector<char>& out) {
+	std::vector<uint32_t> values(indices, indices + n);
+	delta_encode(values.data(), n);
+	stream_vbyte_encode(values.data(), n, out);
+}
+
+static bool decode_index_block(const uint8_t* in, const uint8_t* end, size_t n, uint32_t* indices) {
+	if (stream_vbyte_decode(in, end, n, indices) == nullptr) return false;
+	delta_decode(indices, n);
+	return true;
+}
+
+/*
+Streams
+*/
+
+template <typename T, typename EncodeBlock>
+static void encode_stream(const T* values, size_t count, size_t block_size, std::vector<char>& encoded, EncodeBlock encode_block) {
+	size_t num_blocks = (count + block_size - 1) / block_size;
+	std::vector<std::vector<char>> blocks(num_blocks);
+	parallel_for(num_blocks, [&](int b) {
+		size_t first = b * block_size;
+		encode_block(values + first, std::min(block_size, count - first), blocks[b]);
+	});
+
+	std::vector<uint64_t> header(2 + num_blocks + 1);
+	header[0] = count;
+	header[1] = num_blocks;
+	uint64_t offset = header.size() * sizeof(uint64_t);
+	for (size_t b = 0; b < num_blocks; b++) {
+		header[2 + b] = offset;
+		offset += blocks[b].size();
+	}
+	header[2 + num_blocks] = offset;
+
+	encoded.clear();
+	encoded.reserve(offset);
+	const char* header_bytes = reinterpret_cast<const char*>(header.data());
+	encoded.insert(encoded.end(), header_bytes, header_bytes + header.size() * sizeof(uint64_t));
+	for (size_t b = 0; b < num_blocks; b++) {
+		encoded.insert(encoded.end(), blocks[b].begin(), blocks[b].end());
+	}
+}
+
+template <typename T, typename DecodeBlock>
+static bool decode_stream(const char* encoded, size_t size, size_t block_size, T* values, DecodeBlock decode_block) {
+
+	// check the header and the block offsets
+	uint64_t count;
+	if (!encoded_count(encoded, size, count)) return false;
+	uint64_t num_blocks;
+	memcpy(&num_blocks, encoded + sizeof(uint64_t), sizeof(uint64_t));
+	if (num_blocks != (count + block_size - 1) / block_size) return false;
+	if (num_blocks + 3 > size / sizeof(uint64_t)) return false;
+	std::vector<uint64_t> offsets(num_blocks + 1);
+	memcpy(offsets.data(), encoded + 2 * sizeof(uint64_t), offsets.size() * sizeof(uint64_t));
+	if (offsets[0] != (num_blocks + 3) * sizeof(uint64_t)) return false;
+	for (size_t b = 0; b < num_blocks; b++) {
+		if (offsets[b + 1] < offsets[b]) return false;
+	}
+	if (offsets[num_blocks] > size) return false;
+
+	// decode the blocks
+	std::atomic<bool> valid(true);
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(encoded);
+	parallel_for(num_blocks, [&](int b) {
+		size_t first = b * block_size;
+		size_t n = std::min<size_t>(block_size, count - first);
+		if (!decode_block(bytes + offsets[b], bytes + offsets[b + 1], n, values + first)) valid = false;
+	});
+	return valid;
+}
+
+bool encoded_count(const char* encoded, size_t size, uint64_t& count) {
+	if (size < 2 * sizeof(uint64_t)) return false;
+	memcpy(&count, encoded, sizeof(uint64_t));
+	return true;
+}
+
+void encode_vertices(const Vertex* vertices, size_t count, std::vector<char>& encoded) {
+	encode_stream(vertices, count, CODEC_VERTEX_BLOCK_SIZE, encoded, encode_vertex_block<Vertex>);
+}
+
+void encode_vertices(const VertexWithTangent* vertices, size_t count, std::vector<char>& encoded) {
+	encode_stream(vertices, count, CODEC_VERTEX_BLOCK_SIZE, encoded, encode_vertex_block<VertexWithTangent>);
+}
+
+void encode_indices(const uint32_t* indices, size_t count, std::vector<char>& encoded) {
+	encode_stream(indices, count, CODEC_INDEX_BLOCK_SIZE, encoded, encode_index_block);
+}
+
+bool decode_vertices(const char* encoded, size_t size, Vertex* vertices) {
+	return decode_stream(encoded, size, CODEC_VERTEX_BLOCK_SIZE, vertices, decode_vertex_block<Vertex>);
+}
+
+bool decode_vertices(const char* encoded, size_t size, VertexWithTangent* vertices) {
+	return decode_stream(encoded, size, CODEC_VERTEX_BLOCK_SIZE, vertices, decode_vertex_block<VertexWithTangent>);
+}
+
+bool decode_indices(const char* encoded, size_t size, uint32_t* indices) {
+	return decode_stream(encoded, size, CODEC_INDEX_BLOCK_SIZE, indices, decode_index_block);
+}
\ No newline at end of file
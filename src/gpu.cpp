@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include <set>
 
@@ -12,10 +14,27 @@ const std::vector<const char*> validationLayers = {
 };
 #endif
 
+// descriptor indexing lets the textures be one array in a single descriptor
+// set, it needs maintenance3 on Vulkan 1.0
 const std::vector<const char*> deviceExtensions = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+    VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
 };
 
+static bool hasDeviceExtension(VkPhysicalDevice device, const char* name) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, name) == 0) return true;
+    }
+    return false;
+}
+
 QueueFamilyIndices::QueueFamilyIndices(VkPhysicalDevice device, VkSurfaceKHR surface) {
     
     uint32_t queueFamilyCount = 0;
@@ -73,6 +92,11 @@ GPU::GPU() {
     physical_gpu = VK_NULL_HANDLE;
     logical_gpu = VK_NULL_HANDLE;
     min_uboOffset = 0;
+    textureCompressionBC = false;
+    maxSampledImages = 0;
+    multiDrawIndirect = false;
+    maxDrawIndirectCount = 0;
+    cmdDrawIndexedIndirectCount = nullptr;
     graphicsQueue = VK_NULL_HANDLE;
     presentQueue = VK_NULL_HANDLE;
     commandPool = VK_NULL_HANDLE;
@@ -85,9 +109,15 @@ GPU::GPU(VkInstance vulkan_instance, VkSurfaceKHR surface) {
     vkGetPhysicalDeviceProperties(physical_gpu, &device_properties);
     min_uboOffset = device_properties.limits.minUniformBufferOffsetAlignment;
 
+    // how many textures the fragment shader can sample from one set
+    const VkPhysicalDeviceLimits& limits = device_properties.limits;
+    maxSampledImages = std::min({ limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages,
+        limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+    maxDrawIndirectCount = limits.maxDrawIndirectCount;
+
     QueueFamilyIndices indices(physical_gpu, surface);
 
-    createLogicalDevice(surface, indices);
+    createLogicalDevice(vulkan_instance, indices);
 
     vkGetDeviceQueue(logical_gpu, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(logical_gpu, indices.presentFamily.value(), 0, &presentQueue);
@@ -124,7 +154,7 @@ void GPU::pickPhysicalDevice(VkInstance vulkan_instance, VkSurfaceKHR surface) {
     }
 }
 
-void GPU::createLogicalDevice(VkSurfaceKHR surface, QueueFamilyIndices& indices) {
+void GPU::createLogicalDevice(VkInstance vulkan_instance, QueueFamilyIndices& indices) {
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
@@ -138,19 +168,67 @@ void GPU::createLogicalDevice(VkSurfaceKHR surface, QueueFamilyIndices& indices)
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // the textures are block compressed only if the device can sample BC formats
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physical_gpu, &supportedFeatures);
+    textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.textureCompressionBC = textureCompressionBC ? VK_TRUE : VK_FALSE;
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+
+    // many draws in one indirect call, each with its own first instance that
+    // looks up its draw data
+    multiDrawIndirect = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+    deviceFeatures.multiDrawIndirect = multiDrawIndirect ? VK_TRUE : VK_FALSE;
+    deviceFeatures.drawIndirectFirstInstance = multiDrawIndirect ? VK_TRUE : VK_FALSE;
+
+    // the texture table is an array of a size chosen when its set is
+    // allocated, indexed with the texture of each draw which differs within
+    // an indirect call, and only the elements in use are written
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexing{};
+    supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2KHR supportedFeatures2{};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    supportedFeatures2.pNext = &supportedIndexing;
+    auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(vulkan_instance,
+        "vkGetPhysicalDeviceFeatures2KHR");
+    if (getFeatures2 == nullptr) {
+        throw std::runtime_error("failed to query descriptor indexing features!");
+    }
+    getFeatures2(physical_gpu, &supportedFeatures2);
+    if (!supportedFeatures.shaderSampledImageArrayDynamicIndexing || !supportedIndexing.runtimeDescriptorArray ||
+        !supportedIndexing.shaderSampledImageArrayNonUniformIndexing ||
+        !supportedIndexing.descriptorBindingVariableDescriptorCount || !supportedIndexing.descriptorBindingPartiallyBound) {
+        throw std::runtime_error("failed to find descriptor indexing support for the texture table!");
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &indexingFeatures;
 
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    // the indirect draws take their count from a buffer where the device
+    // supports VK_KHR_draw_indirect_count
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    bool drawIndirectCount = multiDrawIndirect &&
+        hasDeviceExtension(physical_gpu, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (drawIndirectCount) enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -163,6 +241,11 @@ void GPU::createLogicalDevice(VkSurfaceKHR surface, QueueFamilyIndices& indices)
     if (vkCreateDevice(physical_gpu, &createInfo, nullptr, &logical_gpu) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device!");
     }
+
+    if (drawIndirectCount) {
+        cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(logical_gpu,
+            "vkCmdDrawIndexedIndirectCountKHR");
+    }
 }
 
 VkShaderModule GPU::createShaderModule(const std::vector<char>& code) {
@@ -179,14 +262,14 @@ VkShaderModule GPU::createShaderModule(const std::vector<char>& code) {
     return shaderModule;
 }
 
-void GPU::createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples, VkFormat format, VkImageUsageFlags usage, VkImage& image) {
+void GPU::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageUsageFlags usage, VkImage& image) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = format;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -200,7 +283,7 @@ void GPU::createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits num
     }
 }
 
-VkImageView GPU::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) {
+VkImageView GPU::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
@@ -208,7 +291,7 @@ VkImageView GPU::createImageView(VkImage image, VkFormat format, VkImageAspectFl
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -326,8 +409,16 @@ void GPU::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+    // wait for these commands only, not for everything else on the queue
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence;
+    if (vkCreateFence(logical_gpu, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create fence!");
+    }
+    vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence);
+    vkWaitForFences(logical_gpu, 1, &fence, VK_TRUE, UINT64_MAX);
+    vkDestroyFence(logical_gpu, fence, nullptr);
 
     vkFreeCommandBuffers(logical_gpu, commandPool, 1, &commandBuffer);
 }
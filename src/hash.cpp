@@ -0,0 +1,52 @@
+#include <cstring>
+#include <vector>
+
+#include "hash.h"
+#include "parallel.h"
+
+// the block size of hash_bytes_parallel, changing it changes the hashes
+static const size_t HASH_PIECE_SIZE = 1 << 20;
+
+static const uint64_t HASH_MULTIPLIER_1 = 0x9E3779B97F4A7C15ull;
+static const uint64_t HASH_MULTIPLIER_2 = 0xBF58476D1CE4E5B9ull;
+
+static uint64_t mix(uint64_t h) {
+	h ^= h >> 31;
+	h *= HASH_MULTIPLIER_2;
+	h ^= h >> 29;
+	return h;
+}
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed) {
+	/*
+	Eight bytes at a time, then the tail
+	*/
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t h = seed ^ (size * HASH_MULTIPLIER_1);
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		h = (h ^ mix(word * HASH_MULTIPLIER_1)) * HASH_MULTIPLIER_2;
+		h = (h << 27) | (h >> 37);
+	}
+	uint64_t tail = 0;
+	for (size_t j = 0; i < size; i++, j += 8) tail |= uint64_t(bytes[i]) << j;
+	h = (h ^ mix(tail * HASH_MULTIPLIER_1)) * HASH_MULTIPLIER_2;
+	return mix(h);
+}
+
+uint64_t hash_combine(uint64_t seed, uint64_t value) {
+	return mix((seed ^ mix(value)) * HASH_MULTIPLIER_1);
+}
+
+uint64_t hash_bytes_parallel(const void* data, size_t size) {
+	size_t num_pieces = (size + HASH_PIECE_SIZE - 1) / HASH_PIECE_SIZE;
+	std::vector<uint64_t> piece_hashes(num_pieces);
+	parallel_for(num_pieces, [&](int i) {
+		size_t begin = i * HASH_PIECE_SIZE;
+		size_t piece_size = size - begin < HASH_PIECE_SIZE ? size - begin : HASH_PIECE_SIZE;
+		piece_hashes[i] = hash_bytes(static_cast<const char*>(data) + begin, piece_size);
+	});
+	return hash_bytes(piece_hashes.data(), piece_hashes.size() * sizeof(uint64_t), size);
+}
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <stb_image.h>
+
+#include "image_loader.h"
+#include "parallel.h"
+#include "texture_compression.h"
+
+// number of the slowest images to report
+static const int NUM_SLOWEST_IMAGES = 10;
+
+static void copy_flipped(
+	const stbi_uc* pixels,
+	int file_channels,
+	int width,
+	int height,
+	int num_channels,
+	unsigned char* destination
+) {
+	/*
+	Flip the rows so the first row in memory is the bottom of the image, and
+	expand grey, grey + alpha and rgb pixels to num_channels channels in the
+	same pass
+	*/
+	size_t row_size = size_t(width) * num_channels;
+	for (int y = 0; y < height; y++) {
+		const stbi_uc* source = pixels + size_t(height - 1 - y) * width * file_channels;
+		unsigned char* row = destination + y * row_size;
+		if (file_channels == num_channels) {
+			memcpy(row, source, row_size);
+			continue;
+		}
+		for (int x = 0; x < width; x++) {
+			const stbi_uc* in = source + x * file_channels;
+			unsigned char* out = row + x * num_channels;
+			if (file_channels < 3) {
+				out[0] = in[0];
+				out[1] = in[0];
+				out[2] = in[0];
+			} else {
+				out[0] = in[0];
+				out[1] = in[1];
+				out[2] = in[2];
+			}
+			if (num_channels == 4) out[3] = file_channels == 2 ? in[1] : file_channels == 4 ? in[3] : 255;
+		}
+	}
+}
+
+struct SrgbTables {
+	/*
+	Conversions between 8-bit srgb and linear values for filtering
+	*/
+	float to_linear[256];
+	unsigned char to_srgb[4096];
+
+	SrgbTables() {
+		for (int i = 0; i < 256; i++) {
+			float c = i / 255.0f;
+			to_linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < 4096; i++) {
+			float c = i / 4095.0f;
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+			to_srgb[i] = (unsigned char)std::lround(std::min(std::max(s, 0.0f), 1.0f) * 255.0f);
+		}
+	}
+};
+
+static const SrgbTables srgb_tables;
+
+static void downsample(
+	const unsigned char* source,
+	int width,
+	int height,
+	int num_channels,
+	bool srgb,
+	unsigned char* destination
+) {
+	/*
+	Average 2x2 blocks into the next mip level, the last row or column is
+	repeated when a size is odd. The alpha channel is always linear.
+	*/
+	int next_width = std::max(width / 2, 1);
+	int next_height = std::max(height / 2, 1);
+	for (int y = 0; y < next_height; y++) {
+		const unsigned char* row_0 = source + size_t(std::min(2 * y, height - 1)) * width * num_channels;
+		const unsigned char* row_1 = source + size_t(std::min(2 * y + 1, height - 1)) * width * num_channels;
+		unsigned char* out = destination + size_t(y) * next_width * num_channels;
+		for (int x = 0; x < next_width; x++) {
+			int x_0 = std::min(2 * x, width - 1) * num_channels;
+			int x_1 = std::min(2 * x + 1, width - 1) * num_channels;
+			for (int c = 0; c < num_channels; c++) {
+				if (srgb && c < 3) {
+					const float* to_linear = srgb_tables.to_linear;
+					float sum = to_linear[row_0[x_0 + c]] + to_linear[row_0[x_1 + c]] +
+						to_linear[row_1[x_0 + c]] + to_linear[row_1[x_1 + c]];
+					out[x * num_channels + c] = srgb_tables.to_srgb[int(sum * (4095.0f / 4.0f) + 0.5f)];
+				} else {
+					int sum = row_0[x_0 + c] + row_0[x_1 + c] + row_1[x_0 + c] + row_1[x_1 + c];
+					out[x * num_channels + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+uint32_t mip_level_count(int width, int height) {
+	uint32_t levels = 1;
+	while ((width | height) > 1) {
+		width /= 2;
+		height /= 2;
+		levels++;
+	}
+	return levels;
+}
+
+static BlockFormat planned_format(ImageEncoding encoding) {
+	/*
+	The largest block format an encoding can choose
+	*/
+	switch (encoding) {
+	case ENCODING_COLOR_BC: return BLOCK_BC3;
+	case ENCODING_NORMAL_BC: return BLOCK_BC5;
+	default: return BLOCK_NONE;
+	}
+}
+
+uint64_t level_size(int width, int height, int num_channels, BlockFormat format) {
+	if (format == BLOCK_NONE) return uint64_t(width) * height * num_channels;
+	return compressed_size(width, height, format);
+}
+
+std::vector<ImageSlot> plan_image_slots(
+	const std::vector<std::string>& file_paths,
+	int num_channels,
+	ImageEncoding encoding,
+	bool cpu_mip_chain,
+	uint64_t& total_size
+) {
+	std::vector<ImageSlot> slots(file_paths.size());
+	parallel_for(slots.size(), [&](int i) {
+		int file_channels;
+		slots[i].file_path = file_paths[i];
+		if (!stbi_info(file_paths[i].c_str(), &slots[i].width, &slots[i].height, &file_channels)) {
+			throw std::runtime_error("failed to load texture image " + file_paths[i]);
+		}
+		slots[i].decode_time = 0.0;
+		slots[i].mip_levels = mip_level_count(slots[i].width, slots[i].height);
+		slots[i].first_level = 0;
+		slots[i].encoding = encoding;
+		slots[i].format = planned_format(encoding);
+	});
+
+	// a copy from the staging buffer has to start at a multiple of 4 and of
+	// the pixel or block size
+	BlockFormat format = planned_format(encoding);
+	uint64_t alignment = format == BLOCK_NONE ? 4 * num_channels : 16;
+	if (format != BLOCK_NONE) cpu_mip_chain = true;
+	total_size = 0;
+	for (int i = 0; i < slots.size(); i++) {
+		ImageSlot& slot = slots[i];
+		slot.offset = total_size;
+		int width = slot.width;
+		int height = slot.height;
+		uint32_t num_levels = cpu_mip_chain ? slot.mip_levels : 1;
+		for (uint32_t level = 0; level < num_levels; level++) {
+			slot.level_offsets.push_back(total_size);
+			total_size += (level_size(width, height, num_channels, format) + alignment - 1) / alignment * alignment;
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+		slot.size = total_size - slot.offset;
+	}
+	return slots;
+}
+
+ImageSlot image_slot_levels(const ImageSlot& slot, uint32_t first_level) {
+	if (slot.first_level != 0 || slot.level_offsets.size() != slot.mip_levels || first_level >= slot.mip_levels) {
+		throw std::runtime_error("failed to take the mip levels of " + slot.file_path + ", the slot has no whole mip chain");
+	}
+	ImageSlot levels = slot;
+	levels.width = std::max(slot.width >> first_level, 1);
+	levels.height = std::max(slot.height >> first_level, 1);
+	levels.mip_levels = slot.mip_levels - first_level;
+	levels.first_level = first_level;
+	levels.offset = 0;
+	levels.size = slot.offset + slot.size - slot.level_offsets[first_level];
+	levels.level_offsets.assign(slot.level_offsets.begin() + first_level, slot.level_offsets.end());
+	for (uint64_t& offset : levels.level_offsets) offset -= slot.level_offsets[first_level];
+	return levels;
+}
+
+void decode_image(ImageSlot& slot, int num_channels, bool srgb, char* staging) {
+	int width;
+	int height;
+	int file_channels;
+	stbi_uc* pixels = stbi_load(slot.file_path.c_str(), &width, &height, &file_channels, 0);
+	if (!pixels) throw std::runtime_error("failed to load texture image " + slot.file_path);
+	if (width != slot.width || height != slot.height) {
+		stbi_image_free(pixels);
+		throw std::runtime_error("failed to load texture image " + slot.file_path + ", it changed while loading");
+	}
+	if (slot.level_offsets.size() == 1 && slot.encoding == ENCODING_RAW) {
+		copy_flipped(pixels, file_channels, width, height, num_channels,
+			reinterpret_cast<unsigned char*>(staging + slot.offset));
+		stbi_image_free(pixels);
+	} else {
+
+		// filter the mip levels in ordinary memory, the mapped staging
+		// buffer can be slow to read
+		std::vector<unsigned char> level(size_t(width) * height * num_channels);
+		std::vector<unsigned char> next_level;
+		copy_flipped(pixels, file_channels, width, height, num_channels, level.data());
+		stbi_image_free(pixels);
+		if (slot.encoding == ENCODING_COLOR_BC) {
+			slot.format = is_opaque(level.data(), size_t(width) * height) ? BLOCK_BC1 : BLOCK_BC3;
+		}
+		for (int index = 0; index < slot.level_offsets.size(); index++) {
+			unsigned char* destination = reinterpret_cast<unsigned char*>(staging + slot.level_offsets[index]);
+			if (slot.format == BLOCK_NONE) memcpy(destination, level.data(), level.size());
+			else compress_image(level.data(), width, height, slot.format, destination);
+			if (index + 1 == slot.level_offsets.size()) break;
+			int next_width = std::max(width / 2, 1);
+			int next_height = std::max(height / 2, 1);
+			next_level.resize(size_t(next_width) * next_height * num_channels);
+			downsample(level.data(), width, height, num_channels, srgb, next_level.data());
+			level.swap(next_level);
+			width = next_width;
+			height = next_height;
+		}
+	}
+}
+
+void report_decode_times(std::string name, const std::vector<ImageSlot>& slots, double wall_time) {
+	double total_time = 0.0;
+	std::vector<int> order(slots.size());
+	for (int i = 0; i < slots.size(); i++) {
+		total_time += slots[i].decode_time;
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return slots[a].decode_time > slots[b].decode_time;
+	});
+
+	std::cout << "decoded " << slots.size() << " " << name << " in " << wall_time << " ms (" << total_time
+		<< " ms of decode time on " << get_num_workers() << " workers), slowest:" << std::endl;
+	for (int i = 0; i < std::min<int>(NUM_SLOWEST_IMAGES, order.size()); i++) {
+		const ImageSlot& slot = slots[order[i]];
+		std::cout << "  " << slot.decode_time << " ms " << slot.file_path << " ("
+			<< slot.width << "x" << slot.height << ")" << std::endl;
+	}
+}
+
+void report_texture_memory(std::string name, const std::vector<ImageSlot>& slots, int num_channels) {
+	uint64_t size = 0;
+	uint64_t uncompressed_size = 0;
+	int num_compressed = 0;
+	for (const ImageSlot& slot : slots) {
+		int width = slot.width;
+		int height = slot.height;
+		for (uint32_t level = 0; level < slot.mip_levels; level++) {
+			size += level_size(width, height, num_channels, slot.format);
+			uncompressed_size += level_size(width, height, num_channels, BLOCK_NONE);
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+		if (slot.format != BLOCK_NONE) num_compressed++;
+	}
+	std::cout << name << ": " << size / 1048576.0 << " MB, " << uncompressed_size / 1048576.0
+		<< " MB uncompressed, saved " << (uncompressed_size - size) / 1048576.0 << " MB with "
+		<< num_compressed << " of " << slots.size() << " block compressed" << std::endl;
+}
\ No newline at end of file
@@ -1,10 +1,21 @@
 #include <fstream>
+#include <string_view>
 #include <iostream>
 #include <glm/glm.hpp>
 
 #include "light.h"
 #include "string_utils.h"
 
+void parse_light_values(std::string_view line, float* values, int count) {
+	/*
+	Parse the numbers after the light type into values[1], ..., values[count]
+	*/
+	next_token(line, ' ');
+	for (int i = 1; i <= count; i++) {
+		if (!parse_float(next_token(line, ' '), values[i])) throw std::invalid_argument("failed to parse a light value");
+	}
+}
+
 light::light() {
 	num_unattenuated_point_light = 0;
 	num_directional_light = 0;
@@ -25,56 +36,61 @@ void light::load_file(std::string file_path) {
 	while (!file.eof()) {
 		std::string line;
 		std::getline(file, line);
-		if (line.substr(0, 3) == "pna") {
+		std::string_view view = line;
+		if (view.substr(0, 3) == "pna") {
 			num_unattenuated_point_light += 1;
-			std::vector<std::string> values = split(line, ' ');
+			float values[7];
+			parse_light_values(view, values, 6);
 			int light_index = num_unattenuated_point_light - 1;
-			unattenuated_point_light[light_index].pos.x = std::stof(values[1]);
-			unattenuated_point_light[light_index].pos.y = std::stof(values[2]);
-			unattenuated_point_light[light_index].pos.z = std::stof(values[3]);
-			unattenuated_point_light[light_index].col.r = std::stof(values[4]);
-			unattenuated_point_light[light_index].col.g = std::stof(values[5]);
-			unattenuated_point_light[light_index].col.b = std::stof(values[6]);
+			unattenuated_point_light[light_index].pos.x = values[1];
+			unattenuated_point_light[light_index].pos.y = values[2];
+			unattenuated_point_light[light_index].pos.z = values[3];
+			unattenuated_point_light[light_index].col.r = values[4];
+			unattenuated_point_light[light_index].col.g = values[5];
+			unattenuated_point_light[light_index].col.b = values[6];
 		}
-		if (line.substr(0, 3) == "dir") {
+		if (view.substr(0, 3) == "dir") {
 			num_directional_light += 1;
-			std::vector<std::string> values = split(line, ' ');
+			float values[7];
+			parse_light_values(view, values, 6);
 			int light_index = num_directional_light - 1;
-			directional_light[light_index].dir.x = std::stof(values[1]);
-			directional_light[light_index].dir.y = std::stof(values[2]);
-			directional_light[light_index].dir.z = std::stof(values[3]);
-			directional_light[light_index].col.r = std::stof(values[4]);
-			directional_light[light_index].col.g = std::stof(values[5]);
-			directional_light[light_index].col.b = std::stof(values[6]);
+			directional_light[light_index].dir.x = values[1];
+			directional_light[light_index].dir.y = values[2];
+			directional_light[light_index].dir.z = values[3];
+			directional_light[light_index].col.r = values[4];
+			directional_light[light_index].col.g = values[5];
+			directional_light[light_index].col.b = values[6];
 		}
-		if (line.substr(0, 3) == "pwa") {
+		if (view.substr(0, 3) == "pwa") {
 			num_point_light += 1;
-			std::vector<std::string> values = split(line, ' ');
+			float values[8];
+			parse_light_values(view, values, 7);
 			int light_index = num_point_light - 1;
-			point_light[light_index].pos.x = std::stof(values[1]);
-			point_light[light_index].pos.y = std::stof(values[2]);
-			point_light[light_index].pos.z = std::stof(values[3]);
-			point_light[light_index].col.r = std::stof(values[4]);
-			point_light[light_index].col.g = std::stof(values[5]);
-			point_light[light_index].col.b = std::stof(values[6]);
-			point_light[light_index].falloff = std::stof(values[7]);
+			point_light[light_index].pos.x = values[1];
+			point_light[light_index].pos.y = values[2];
+			point_light[light_index].pos.z = values[3];
+			point_light[light_index].col.r = values[4];
+			point_light[light_index].col.g = values[5];
+			point_light[light_index].col.b = values[6];
+			point_light[light_index].falloff = values[7];
 		}
-		if (line.substr(0, 3) == "spo") {
+		if (view.substr(0, 3) == "spo") {
 			num_spot_light += 1;
-			std::vector<std::string> values = split(line, ' ');
+			float values[13];
+			parse_light_values(view, values, 12);
 			int light_index = num_spot_light - 1;
-			spot_light[light_index].pos.x = std::stof(values[1]);
-			spot_light[light_index].pos.y = std::stof(values[2]);
-			spot_light[light_index].pos.z = std::stof(values[3]);
-			spot_light[light_index].dir.x = std::stof(values[4]) - spot_light[light_index].pos.x;
-			spot_light[light_index].dir.y = std::stof(values[5]) - spot_light[light_index].pos.y;
-			spot_light[light_index].dir.z = std::stof(values[6]) - spot_light[light_index].pos.z;
-			spot_light[light_index].col.r = std::stof(values[7]);
-			spot_light[light_index].col.g = std::stof(values[8]);
-			spot_light[light_index].col.b = std::stof(values[9]);
-			spot_light[light_index].cos_p = cos(glm::radians(std::stof(values[10])));
-			spot_light[light_index].cos_u = cos(glm::radians(std::stof(values[11])));
-			spot_light[light_index].falloff = std::stof(values[12]);
+			spot_light[light_index].pos.x = values[1];
+			spot_light[light_index].pos.y = values[2];
+			spot_light[light_index].pos.z = values[3];
+			spot_light[light_index].dir.x = values[4] - spot_light[light_index].pos.x;
+			spot_light[light_index].dir.y = values[5] - spot_light[light_index].pos.y;
+			spot_light[light_index].dir.z = values[6] - spot_light[light_index].pos.z;
+			spot_light[light_index].col.r = values[7];
+			spot_light[light_index].col.g = values[8];
+			spot_light[light_index].col.b = values[9];
+			spot_light[light_index].cos_p = cos(glm::radians(values[10]));
+			spot_light[light_index].cos_u = cos(glm::radians(values[11]));
+			spot_light[light_index].falloff = values[12];
 		}
 	}
 	file.close();
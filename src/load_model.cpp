@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <fstream>
 #include <unordered_map>
 #include <unordered_set>
@@ -5,355 +6,589 @@
 #include <stack>
 #include <filesystem>
 #include <utility>
+#include <string_view>
+#include <climits>
+#include <cstring>
+#include <stb_image.h>
 
 #include "sm_math.h"
 #include "load_model.h"
+#include "frustum_culling.h"
+#include "hash.h"
+#include "image_loader.h"
+#include "mapped_file.h"
+#include "obj_parser.h"
+#include "parallel.h"
+#include "scene_bvh.h"
+#include "scene_cache.h"
 #include "string_utils.h"
-
-glm::vec3 parse_coordinates(std::string line, int start) {
-	std::vector<std::string> coordinates = split(line.substr(start), ' ');
-	return glm::vec3(std::stof(coordinates[0]), std::stof(coordinates[1]), std::stof(coordinates[2]));
-}
-
-glm::vec2 parse_uv(std::string line) {
-	std::vector<std::string> values = split(line.substr(3), ' ');
-	return glm::vec2(std::stof(values[0]), std::stof(values[1]));
-}
-
-void serialize(
-	Scene* scene,
-	std::string out_path
+#include "timer.h"
+#include "vertex_weld.h"
+
+// bump this whenever the loader builds a different scene from the same obj,
+// so older caches are imported again and their meshes are not reused
+const uint32_t OBJ_LOADER_VERSION = 2;
+
+struct PreviousImport {
+	/*
+	The geometry of a stale cache. A group whose signature is in here is
+	copied instead of being built again.
+	*/
+	std::vector<Vertex> vertices;
+	std::vector<VertexWithTangent> vertices_with_tangent;
+	std::vector<uint32_t> indices;
+	std::vector<Mesh> meshes;
+	std::vector<MeshWithNormalMap> meshes_with_normal_map;
+
+	// signature -> index into meshes, or into meshes_with_normal_map after
+	// the number of meshes
+	std::unordered_map<uint64_t, int> signatures;
+};
+
+struct ImageDedup {
+	/*
+	How many images the materials reference and how many of them turned out
+	to be the same file or the same contents as an earlier one
+	*/
+	int num_references = 0;
+	int num_same_path = 0;
+	int num_same_content = 0;
+
+	// rgba8 bytes with full mip chains of the images that were dropped
+	uint64_t saved_size = 0;
+};
+
+struct MeshSlot {
+	/*
+	Where the mesh of an obj group goes: index mesh of scene->meshes, or of
+	scene->meshes_with_normal_map when the material has a normal map. The
+	geometry is built here first and moved into the scene once every mesh
+	knows its offsets.
+	*/
+	int group;
+	int mesh;
+	int texture_index;
+	int normal_map_index;
+	uint64_t signature;
+	bool reused;
+	std::vector<Vertex> vertices;
+	std::vector<VertexWithTangent> vertices_with_tangent;
+	std::vector<uint32_t> indices;
+};
+
+template <typename VertexType>
+void load_group_geometry(
+	const ObjData& data,
+	const ObjGroup& group,
+	std::vector<VertexType>& vertices,
+	std::vector<uint32_t>& indices
 ) {
-
-	// open the file
-	std::ofstream file(
-		out_path.c_str(),
-		std::ofstream::binary | std::ofstream::out | std::ofstream::trunc
-	);
-
-	// serialize meshes
-	uint16_t num_meshes = scene->meshes.size();
-	file.write(reinterpret_cast<char*>(&num_meshes), sizeof(uint16_t));
-	for (int i = 0; i < num_meshes; i++) {
-		scene->meshes[i].serialize(file);
-	}
-
-	// serialize meshes with normal map
-	uint16_t num_meshes_with_normal_map = scene->meshes_with_normal_map.size();
-	file.write(reinterpret_cast<char*>(&num_meshes_with_normal_map), sizeof(uint16_t));
-	for (int i = 0; i < num_meshes_with_normal_map; i++) {
-		scene->meshes_with_normal_map[i].serialize(file);
+	/*
+	Weld the face vertices that have the same index triplet and split the
+	quads into triangles
+	*/
+
+	int index = 0;
+	VertexWeldTable unique_vertices(group.vertex_indices.size() / 3);
+	std::vector<uint32_t> face_indices;
+	const int* triplet = group.vertex_indices.data();
+	for (int j = 0; j < group.face_sizes.size(); j++) {
+		face_indices.clear();
+		for (int k = 0; k < group.face_sizes[j]; k++, triplet += 3) {
+			int found = unique_vertices.find_or_insert(triplet[0], triplet[1], triplet[2], index);
+			if (found < 0) {
+				face_indices.push_back(index);
+				vertices.emplace_back(
+					data.coordinates[triplet[0] - 1],
+					data.normals[triplet[2] - 1],
+					data.uv[triplet[1] - 1]
+				);
+				index++;
+			}
+			else face_indices.push_back(found);
+		}
+		if (face_indices.size() == 4) {
+			uint32_t triangles[] = { face_indices[0], face_indices[1], face_indices[2], face_indices[2], face_indices[3], face_indices[0] };
+			indices.insert(indices.end(), triangles, triangles + 6);
+		}
+		else if (face_indices.size() == 3) {
+			indices.insert(indices.end(), face_indices.begin(), face_indices.end());
+		}
 	}
+}
 
-	// serialize textures
-	uint16_t num_textures = scene->textures.size();
-	file.write(reinterpret_cast<char*>(&num_textures), sizeof(uint16_t));
-	for (int i = 0; i < num_textures; i++) {
-		scene->textures[i].serialize(file);
-	}
+template <typename T>
+uint64_t hash_range(const std::vector<T>& values, int first, int last) {
+	if (first > last) return 0;
+	if (first < 1 || last > values.size()) return 1;
+	return hash_bytes(values.data() + first - 1, (last - first + 1) * sizeof(T));
+}
 
-	// serialize normal maps
-	uint16_t num_normal_maps = scene->normal_maps.size();
-	file.write(reinterpret_cast<char*>(&num_normal_maps), sizeof(uint16_t));
-	for (int i = 0; i < num_normal_maps; i++) {
-		scene->normal_maps[i].serialize(file);
+uint64_t group_signature(const ObjData& data, const ObjGroup& group, bool normal_mapped) {
+	/*
+	Hash everything the geometry of a group is built from: the faces, the
+	vertex attributes they use and the vertex format. The face indices are
+	hashed relative to the first attribute the group uses, so a group keeps
+	its signature when an edit earlier in the file shifts its attributes.
+	*/
+
+	// the range of every attribute that the group uses
+	int first[3] = { INT_MAX, INT_MAX, INT_MAX };
+	int last[3] = { 0, 0, 0 };
+	for (size_t i = 0; i < group.vertex_indices.size(); i += 3) {
+		for (int k = 0; k < 3; k++) {
+			first[k] = std::min(first[k], group.vertex_indices[i + k]);
+			last[k] = std::max(last[k], group.vertex_indices[i + k]);
+		}
 	}
 
-	// serialize debug_nodes
-	uint16_t num_debugs = scene->debug_node_names.size();
-	file.write(reinterpret_cast<char*>(&num_debugs), sizeof(uint16_t));
-	for (int i = 0; i < num_debugs; i++) {
-		uint16_t str_size = scene->debug_node_names[i].size();
-		file.write(reinterpret_cast<char*>(&str_size), sizeof(uint16_t));
-		file.write(scene->debug_node_names[i].c_str(), str_size);
+	std::vector<int> relative_indices(group.vertex_indices.size());
+	for (size_t i = 0; i < group.vertex_indices.size(); i += 3) {
+		for (int k = 0; k < 3; k++) relative_indices[i + k] = group.vertex_indices[i + k] - first[k];
 	}
 
-	// close the file
-	file.close();
+	uint64_t signature = hash_combine(OBJ_LOADER_VERSION, normal_mapped ? 2 : 1);
+	signature = hash_combine(signature, hash_bytes(group.face_sizes.data(), group.face_sizes.size() * sizeof(int)));
+	signature = hash_combine(signature, hash_bytes(relative_indices.data(), relative_indices.size() * sizeof(int)));
+	signature = hash_combine(signature, hash_range(data.coordinates, first[0], last[0]));
+	signature = hash_combine(signature, hash_range(data.uv, first[1], last[1]));
+	signature = hash_combine(signature, hash_range(data.normals, first[2], last[2]));
+	return signature;
 }
 
-void deserialize(
-	Scene* scene,
-	std::string bin_path
+template <typename VertexType>
+void reuse_geometry(
+	const std::vector<VertexType>& previous_vertices,
+	const std::vector<uint32_t>& previous_indices,
+	const MeshBase& previous_mesh,
+	std::vector<VertexType>& vertices,
+	std::vector<uint32_t>& indices
 ) {
+	auto first_vertex = previous_vertices.begin() + previous_mesh.vertex_offset;
+	vertices.assign(first_vertex, first_vertex + previous_mesh.vertex_count);
+	auto first_index = previous_indices.begin() + previous_mesh.index_offset;
+	indices.assign(first_index, first_index + previous_mesh.index_count);
+}
 
-	// open the file
-	std::ifstream file(
-		bin_path.c_str(),
-		std::ifstream::in | std::ifstream::binary
-	);
-
-	// deserialize meshes
-	uint16_t num_meshes;
-	file.read(reinterpret_cast<char*>(&num_meshes), sizeof(uint16_t));
-	scene->meshes.resize(num_meshes);
-	for (int i = 0; i < num_meshes; i++) {
-		scene->meshes[i].deserialize(file);
-	}
-
-	// deserialize meshes with normal map
-	uint16_t num_meshes_with_normal_map;
-	file.read(reinterpret_cast<char*>(&num_meshes_with_normal_map), sizeof(uint16_t));
-	scene->meshes_with_normal_map.resize(num_meshes_with_normal_map);
-	for (int i = 0; i < num_meshes_with_normal_map; i++) {
-		scene->meshes_with_normal_map[i].deserialize(file);
-	}
-
-	// deserialize textures
-	uint16_t num_textures;
-	file.read(reinterpret_cast<char*>(&num_textures), sizeof(uint16_t));
-	scene->textures.resize(num_textures);
-	for (int i = 0; i < num_textures; i++) {
-		scene->textures[i].deserialize(file);
-	}
-
-	// deserialize normal maps
-	uint16_t num_normal_maps;
-	file.read(reinterpret_cast<char*>(&num_normal_maps), sizeof(uint16_t));
-	scene->normal_maps.resize(num_normal_maps);
-	for (int i = 0; i < num_normal_maps; i++) {
-		scene->normal_maps[i].deserialize(file);
+void take_previous_import(Scene* scene, const SceneCacheInfo& info, PreviousImport& previous) {
+	/*
+	Move the geometry of a stale cache out of the scene and index it by
+	signature, leaving the scene empty for the import
+	*/
+	previous.vertices = std::move(scene->vertices);
+	previous.vertices_with_tangent = std::move(scene->vertices_with_tangent);
+	previous.indices = std::move(scene->indices);
+	previous.meshes = std::move(scene->meshes);
+	previous.meshes_with_normal_map = std::move(scene->meshes_with_normal_map);
+	for (int i = 0; i < info.mesh_signatures.size(); i++) {
+		previous.signatures[info.mesh_signatures[i]] = i;
 	}
+	scene->vertices.clear();
+	scene->vertices_with_tangent.clear();
+	scene->indices.clear();
+	scene->meshes.clear();
+	scene->meshes_with_normal_map.clear();
+	scene->textures.clear();
+	scene->normal_maps.clear();
+	scene->debug_node_names.clear();
+}
 
-	// deserialize debug_nodes
-	uint16_t num_debugs;
-	file.read(reinterpret_cast<char*>(&num_debugs), sizeof(uint16_t));
-	scene->debug_node_names.resize(num_debugs);
-	for (int i = 0; i < num_debugs; i++) {
-		uint16_t str_size;
-		file.read(reinterpret_cast<char*>(&str_size), sizeof(uint16_t));
-		scene->debug_node_names[i].resize(str_size);
-		file.read(&scene->debug_node_names[i][0], str_size);
+static uint64_t image_memory(std::string path) {
+	/*
+	The size of an image as rgba8 with its full mip chain, 0 if it can't be
+	read
+	*/
+	int width;
+	int height;
+	int channels;
+	if (!stbi_info(path.c_str(), &width, &height, &channels)) return 0;
+	uint64_t size = 0;
+	for (uint32_t level = 0; level < mip_level_count(width, height); level++) {
+		size += level_size(width, height, 4, BLOCK_NONE);
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
 	}
-
-	// close the file
-	file.close();
+	return size;
 }
 
-void load_meshes_and_textures_obj(
-	Scene* scene,
-	std::string obj_path,
-	std::string mtl_path
+template <typename Image>
+static int add_image(
+	std::vector<Image>& images,
+	std::unordered_map<std::string, int>& image_by_path,
+	std::filesystem::path path,
+	ImageDedup& dedup
 ) {
-
-	// check for serialized file
-	std::string bin_path = obj_path.substr(0, obj_path.length() - 4) + ".bin";
-	if (std::filesystem::exists(bin_path)) {
-		deserialize(scene, bin_path);
-		return;
+	/*
+	The index of the image with this path, added if it is new. Paths are
+	compared after resolving ".." and links, so different spellings of a file
+	share one image.
+	*/
+	dedup.num_references++;
+	std::error_code error;
+	std::filesystem::path canonical_path = std::filesystem::weakly_canonical(path, error);
+	if (error) canonical_path = path.lexically_normal();
+	auto found = image_by_path.find(canonical_path.string());
+	if (found != image_by_path.end()) {
+		dedup.num_same_path++;
+		dedup.saved_size += image_memory(path.string());
+		return found->second;
 	}
+	image_by_path[canonical_path.string()] = images.size();
+	images.emplace_back(path.string());
+	return images.size() - 1;
+}
 
-	// load the file
-	std::ifstream file;
-	file.open(obj_path);
-	if (file.fail()) {
-		std::string fail_message = "failed to open " + obj_path;
-		throw std::runtime_error(fail_message);
-	}
+static bool same_contents(const std::string& path_a, const std::string& path_b) {
+	MappedFile a(path_a);
+	MappedFile b(path_b);
+	return a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+}
 
-	std::vector<glm::vec3> coordinates;
-	std::vector<glm::vec3> normals;
-	std::vector<glm::vec2> uv;
-	std::vector<std::vector<std::string>> faces;
-	std::string object;
-	std::string material;
-	std::vector<std::string> materials;
-	std::vector<std::string> temp;
-
-	// read line by line
-	while (!file.eof()) {
-		std::string line;
-		std::getline(file, line);
-		if (line[0] == 'v' && line[1] == ' ') coordinates.push_back(parse_coordinates(line, 2));
-		if (line[0] == 'v' && line[1] == 'n') normals.push_back(parse_coordinates(line, 3));
-		if (line[0] == 'v' && line[1] == 't') uv.push_back(parse_uv(line));
-		if (line[0] == 'o') {
-			if (!temp.empty()) {
-				faces.push_back(temp);
-				temp.clear();
-				scene->debug_node_names.push_back(object + "_" + material);
-				materials.push_back(material);
-			}
-			object = line.substr(2);
-		}
-		if (line[0] == 'u') {
-			if (!temp.empty()) {
-				faces.push_back(temp);
-				temp.clear();
-				scene->debug_node_names.push_back(object + "_" + material);
-				materials.push_back(material);
-			}
-			material = line.substr(7);
+template <typename Image>
+static std::vector<int> deduplicate_by_content(std::vector<Image>& images, ImageDedup& dedup) {
+	/*
+	Merge the images whose files have the same contents, the first one is
+	kept. The files with the same hash are compared byte by byte, so a
+	collision keeps both. Returns the new index of every old image.
+	*/
+	std::vector<uint64_t> hashes(images.size());
+	parallel_for(images.size(), [&](int i) {
+		MappedFile file(images[i].file_path);
+		hashes[i] = hash_combine(hash_bytes(file.data, file.size), file.size);
+	});
+
+	std::vector<int> remap(images.size());
+	std::unordered_map<uint64_t, int> image_by_hash;
+	std::vector<Image> unique_images;
+	for (int i = 0; i < images.size(); i++) {
+		auto found = image_by_hash.find(hashes[i]);
+		if (found != image_by_hash.end() && same_contents(unique_images[found->second].file_path, images[i].file_path)) {
+			remap[i] = found->second;
+			dedup.num_same_content++;
+			dedup.saved_size += image_memory(images[i].file_path);
+			continue;
 		}
-		if (line[0] == 'f') temp.push_back(line.substr(2));
+		remap[i] = unique_images.size();
+		if (found == image_by_hash.end()) image_by_hash[hashes[i]] = unique_images.size();
+		unique_images.push_back(images[i]);
 	}
-	file.close();
+	images = std::move(unique_images);
+	return remap;
+}
 
-	// get folder path
-	std::filesystem::path file_path_ = std::filesystem::path(obj_path);
-	std::filesystem::path folder_path = file_path_.parent_path();
+static void report_image_dedup(std::string name, const ImageDedup& dedup, int num_images) {
+	std::cout << name << ": " << dedup.num_references << " references, " << num_images << " unique, "
+		<< dedup.num_same_path << " same path, " << dedup.num_same_content << " same content, saved "
+		<< dedup.saved_size / 1048576.0 << " MB of rgba8 and " << dedup.num_same_path + dedup.num_same_content
+		<< " texture table slots" << std::endl;
+}
 
-	// open mtl file
-	file.open(mtl_path);
-	if (file.fail()) {
-		std::string fail_message = "failed to open " + mtl_path;
-		throw std::runtime_error(fail_message);
-	}
+std::unordered_map<std::string, std::pair<int, int>> load_materials(
+	Scene* scene,
+	std::string mtl_path,
+	std::filesystem::path folder_path,
+	bool dedup_by_content,
+	std::vector<std::string>& image_files
+) {
+	/*
+	Read the texture and normal map of every material. The result maps a
+	material name to its texture and normal map indices, -1 if it has none.
+	Materials that use the same image share it, by path and, if
+	dedup_by_content is set, by the contents of the file. image_files gets
+	every file that was compared by its contents.
+	*/
+
+	// map mtl file
+	MappedFile mtl_file(mtl_path);
+	std::string_view mtl_text = mtl_file.text();
 
 	// load the textures and normal maps
 	std::unordered_map<std::string, std::pair<int, int>> material_mapping;
+	std::unordered_map<std::string, int> texture_by_path;
+	std::unordered_map<std::string, int> normal_map_by_path;
+	ImageDedup texture_dedup;
+	ImageDedup normal_map_dedup;
 	std::string diffuse_texture_file;
 	std::string normal_map_file;
 	std::string material_name;
-	while (!file.eof()) {
-		std::string line;
-		std::getline(file, line);
-		if (line[0] == 'n') {
-			if (!material_name.empty()) {
-				if (!diffuse_texture_file.empty()) {
-					material_mapping[material_name].first = scene->textures.size();
-					std::filesystem::path correct_texture_path =
-						std::filesystem::path(folder_path).append(diffuse_texture_file);
-					scene->textures.emplace_back(correct_texture_path.string());
-				} else material_mapping[material_name].first = -1;
-				if (!normal_map_file.empty()) {
-					material_mapping[material_name].second = scene->normal_maps.size();
-					std::filesystem::path correct_normal_map_path =
-						std::filesystem::path(folder_path).append(normal_map_file);
-					scene->normal_maps.emplace_back(correct_normal_map_path.string());
-				} else material_mapping[material_name].second = -1;
-				diffuse_texture_file.clear();
-				normal_map_file.clear();
-			}
-			material_name = line.substr(7);
+	auto add_material = [&]() {
+		std::pair<int, int>& mapping = material_mapping[material_name];
+		mapping.first = -1;
+		mapping.second = -1;
+		if (!diffuse_texture_file.empty()) {
+			mapping.first = add_image(scene->textures, texture_by_path,
+				std::filesystem::path(folder_path).append(diffuse_texture_file), texture_dedup);
 		}
-		if (line.substr(0, 6) == "map_Kd") diffuse_texture_file = line.substr(7);
-		if (line.substr(0, 8) == "map_Bump") normal_map_file = line.substr(9);
-	}
-	file.close();
-	if (!diffuse_texture_file.empty()) {
-		material_mapping[material_name].first = scene->textures.size();
-		std::filesystem::path correct_texture_path =
-			std::filesystem::path(folder_path).append(diffuse_texture_file);
-		scene->textures.emplace_back(correct_texture_path.string());
+		if (!normal_map_file.empty()) {
+			mapping.second = add_image(scene->normal_maps, normal_map_by_path,
+				std::filesystem::path(folder_path).append(normal_map_file), normal_map_dedup);
+		}
+		diffuse_texture_file.clear();
+		normal_map_file.clear();
+	};
+	while (!mtl_text.empty()) {
+		std::string_view view = next_line(mtl_text);
+		if (char_at(view, 0) == 'n') {
+			if (!material_name.empty()) add_material();
+			material_name = view.substr(7);
+		}
+		if (view.substr(0, 6) == "map_Kd") diffuse_texture_file = view.substr(7);
+		if (view.substr(0, 8) == "map_Bump") normal_map_file = view.substr(9);
 	}
-	else material_mapping[material_name].first = -1;
-	if (!normal_map_file.empty()) {
-		material_mapping[material_name].second = scene->normal_maps.size();
-		std::filesystem::path correct_normal_map_path =
-			std::filesystem::path(folder_path).append(normal_map_file);
-		scene->normal_maps.emplace_back(correct_normal_map_path.string());
+	add_material();
+
+	// point the materials at the images with the same contents
+	if (dedup_by_content) {
+		for (const Texture& texture : scene->textures) image_files.push_back(texture.file_path);
+		for (const NormalMap& normal_map : scene->normal_maps) image_files.push_back(normal_map.file_path);
+		std::vector<int> texture_remap = deduplicate_by_content(scene->textures, texture_dedup);
+		std::vector<int> normal_map_remap = deduplicate_by_content(scene->normal_maps, normal_map_dedup);
+		for (auto& material : material_mapping) {
+			if (material.second.first != -1) material.second.first = texture_remap[material.second.first];
+			if (material.second.second != -1) material.second.second = normal_map_remap[material.second.second];
+		}
 	}
-	else material_mapping[material_name].second = -1;
 
-	// create meshes
-	for (int i = 0; i < faces.size(); i++) {
+	report_image_dedup("textures", texture_dedup, scene->textures.size());
+	report_image_dedup("normal maps", normal_map_dedup, scene->normal_maps.size());
+	return material_mapping;
+}
+
+std::vector<MeshSlot> build_meshes(
+	Scene* scene,
+	ObjData& data,
+	std::unordered_map<std::string, std::pair<int, int>>& material_mapping,
+	const PreviousImport& previous
+) {
+
+	// decide which meshes get built and where they go, in file order
+	std::vector<MeshSlot> slots;
+	int num_meshes = 0;
+	int num_meshes_with_normal_map = 0;
+	for (int i = 0; i < data.groups.size(); i++) {
+		auto material = material_mapping.find(data.groups[i].material);
 
 		// skip the meshes without a texture
-		if (material_mapping.find(materials[i]) == material_mapping.end() ||
-			material_mapping[materials[i]].first == -1) continue;
+		if (material == material_mapping.end() || material->second.first == -1) continue;
+
+		slots.emplace_back();
+		MeshSlot& slot = slots.back();
+		slot.group = i;
+		slot.texture_index = material->second.first;
+		slot.normal_map_index = material->second.second;
+		slot.mesh = slot.normal_map_index == -1 ? num_meshes++ : num_meshes_with_normal_map++;
+		slot.reused = false;
+	}
+	scene->meshes.resize(num_meshes);
+	scene->meshes_with_normal_map.resize(num_meshes_with_normal_map);
+
+	// create meshes, each group builds its own mesh so they can run in parallel
+	int num_previous_meshes = previous.meshes.size();
+	parallel_for(slots.size(), [&](int i) {
+		MeshSlot& slot = slots[i];
+		ObjGroup& group = data.groups[slot.group];
+
+		// find out if the previous import already built this mesh
+		slot.signature = group_signature(data, group, slot.normal_map_index != -1);
+		auto found = previous.signatures.find(slot.signature);
+		int previous_mesh = found == previous.signatures.end() ? -1 : found->second;
+		if (slot.normal_map_index == -1) slot.reused = previous_mesh >= 0 && previous_mesh < num_previous_meshes;
+		else slot.reused = previous_mesh >= num_previous_meshes;
 
 		// if this mesh doesn't have a normal map
-		if (material_mapping[materials[i]].second == -1) {
-			
+		if (slot.normal_map_index == -1) {
+
 			// instantiate the mesh
-			Mesh mesh = Mesh();
+			Mesh& mesh = scene->meshes[slot.mesh];
 			mesh.init_transform = glm::mat4(1.0f);
-			mesh.texture_index = material_mapping[materials[i]].first;
-			mesh.debug_node_name = scene->debug_node_names[i];
+			mesh.texture_index = slot.texture_index;
+			mesh.debug_node_name = group.debug_node_name;
 
 			// load vertices and indices
-			int index = 0;
-			std::unordered_map<std::string, int> unique_vertices;
-			for (int j = 0; j < faces[i].size(); j++) {
-				std::vector<std::string> face_vertices = split(faces[i][j], ' ');
-				std::vector<uint32_t> indices;
-				for (int k = 0; k < face_vertices.size(); k++) {
-					if (unique_vertices.find(face_vertices[k]) == unique_vertices.end()) {
-						unique_vertices[face_vertices[k]] = index;
-						indices.push_back(index);
-						std::vector<std::string> pos_uv_nor_indices = split(face_vertices[k], '/');
-						mesh.vertices.emplace_back(
-							coordinates[std::stoi(pos_uv_nor_indices[0]) - 1],
-							normals[std::stoi(pos_uv_nor_indices[2]) - 1],
-							uv[std::stoi(pos_uv_nor_indices[1]) - 1]
-						);
-						index++;
-					}
-					else indices.push_back(unique_vertices[face_vertices[k]]);
-				}
-				if (indices.size() == 4) {
-					std::vector<uint32_t> triangles = { indices[0], indices[1], indices[2], indices[2], indices[3], indices[0] };
-					mesh.indices.insert(mesh.indices.end(), triangles.begin(), triangles.end());
-				}
-				else if (indices.size() == 3) {
-					mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
-				}
+			if (slot.reused) {
+				reuse_geometry(previous.vertices, previous.indices,
+					previous.meshes[previous_mesh], slot.vertices, slot.indices);
 			}
-
-			// done loading this mesh
-			scene->meshes.push_back(mesh);
+			else load_group_geometry(data, group, slot.vertices, slot.indices);
+			mesh.vertex_count = slot.vertices.size();
+			mesh.index_count = slot.indices.size();
 		} else {
-			
+
 			// instantiate the mesh
-			MeshWithNormalMap mesh = MeshWithNormalMap();
+			MeshWithNormalMap& mesh = scene->meshes_with_normal_map[slot.mesh];
 			mesh.init_transform = glm::mat4(1.0f);
-			mesh.texture_index = material_mapping[materials[i]].first;
-			mesh.normal_map_index = material_mapping[materials[i]].second;
-			mesh.debug_node_name = scene->debug_node_names[i];
+			mesh.texture_index = slot.texture_index;
+			mesh.normal_map_index = slot.normal_map_index;
+			mesh.debug_node_name = group.debug_node_name;
 
 			// load vertices and indices
-			int index = 0;
-			std::unordered_map<std::string, int> unique_vertices;
-			for (int j = 0; j < faces[i].size(); j++) {
-				std::vector<std::string> face_vertices = split(faces[i][j], ' ');
-				std::vector<uint32_t> indices;
-				for (int k = 0; k < face_vertices.size(); k++) {
-					if (unique_vertices.find(face_vertices[k]) == unique_vertices.end()) {
-						unique_vertices[face_vertices[k]] = index;
-						indices.push_back(index);
-						std::vector<std::string> pos_uv_nor_indices = split(face_vertices[k], '/');
-						mesh.vertices.emplace_back(
-							coordinates[std::stoi(pos_uv_nor_indices[0]) - 1],
-							normals[std::stoi(pos_uv_nor_indices[2]) - 1],
-							uv[std::stoi(pos_uv_nor_indices[1]) - 1]
-						);
-						index++;
-					} else indices.push_back(unique_vertices[face_vertices[k]]);
-				}
-				if (indices.size() == 4) {
-					std::vector<uint32_t> triangles = { indices[0], indices[1], indices[2], indices[2], indices[3], indices[0] };
-					mesh.indices.insert(mesh.indices.end(), triangles.begin(), triangles.end());
-				} else if (indices.size() == 3) {
-					mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
-				}
+			if (slot.reused) {
+				reuse_geometry(previous.vertices_with_tangent, previous.indices,
+					previous.meshes_with_normal_map[previous_mesh - num_previous_meshes],
+					slot.vertices_with_tangent, slot.indices);
 			}
+			else load_group_geometry(data, group, slot.vertices_with_tangent, slot.indices);
+			mesh.vertex_count = slot.vertices_with_tangent.size();
+			mesh.index_count = slot.indices.size();
+		}
+
+		// the faces of this group are not needed anymore
+		std::vector<int>().swap(group.face_sizes);
+		std::vector<int>().swap(group.vertex_indices);
+	});
+
+	return slots;
+}
 
-			// calculate tangents
-			mesh.calculate_tangent_vectors();
+void assign_mesh_offsets(Scene* scene) {
 
-			// done loading this mesh
-			scene->meshes_with_normal_map.push_back(mesh);
+	// the index buffer is shared so the index offsets keep counting
+	int vertex_offset = 0;
+	int index_offset = 0;
+	for (int i = 0; i < scene->meshes.size(); i++) {
+		scene->meshes[i].vertex_offset = vertex_offset;
+		scene->meshes[i].index_offset = index_offset;
+		vertex_offset += scene->meshes[i].vertex_count;
+		index_offset += scene->meshes[i].index_count;
+	}
+	scene->vertices.resize(vertex_offset);
+	vertex_offset = 0;
+	for (int i = 0; i < scene->meshes_with_normal_map.size(); i++) {
+		scene->meshes_with_normal_map[i].vertex_offset = vertex_offset;
+		scene->meshes_with_normal_map[i].index_offset = index_offset;
+		vertex_offset += scene->meshes_with_normal_map[i].vertex_count;
+		index_offset += scene->meshes_with_normal_map[i].index_count;
+	}
+	scene->vertices_with_tangent.resize(vertex_offset);
+	scene->indices.resize(index_offset);
+}
+
+void pack_mesh_geometry(Scene* scene, std::vector<MeshSlot>& slots) {
+	/*
+	Move the geometry of every mesh to its range of the scene geometry and
+	calculate the tangents and the bounds there
+	*/
+
+	parallel_for(slots.size(), [&](int i) {
+		MeshSlot& slot = slots[i];
+		if (slot.normal_map_index == -1) {
+			Mesh& mesh = scene->meshes[slot.mesh];
+			std::copy(slot.vertices.begin(), slot.vertices.end(), scene->vertices.begin() + mesh.vertex_offset);
+			std::copy(slot.indices.begin(), slot.indices.end(), scene->indices.begin() + mesh.index_offset);
+			mesh.bounds = mesh_bounds(scene->vertices.data() + mesh.vertex_offset, mesh.vertex_count, mesh.init_transform);
+		} else {
+			MeshWithNormalMap& mesh = scene->meshes_with_normal_map[slot.mesh];
+			std::copy(slot.vertices_with_tangent.begin(), slot.vertices_with_tangent.end(),
+				scene->vertices_with_tangent.begin() + mesh.vertex_offset);
+			std::copy(slot.indices.begin(), slot.indices.end(), scene->indices.begin() + mesh.index_offset);
+
+			// calculate tangents, reused meshes already have them
+			if (!slot.reused) mesh.calculate_tangent_vectors(
+				scene->vertices_with_tangent.data() + mesh.vertex_offset,
+				scene->indices.data() + mesh.index_offset
+			);
+			mesh.bounds = mesh_bounds(scene->vertices_with_tangent.data() + mesh.vertex_offset, mesh.vertex_count,
+				mesh.init_transform);
 		}
+		std::vector<Vertex>().swap(slot.vertices);
+		std::vector<VertexWithTangent>().swap(slot.vertices_with_tangent);
+		std::vector<uint32_t>().swap(slot.indices);
+	});
+}
 
-		// update offsets
-		int vertex_offset = 0;
-		int index_offset = 0;
-		for (int i = 0; i < scene->meshes.size(); i++) {
-			scene->meshes[i].vertex_offset = vertex_offset;
-			scene->meshes[i].index_offset = index_offset;
-			vertex_offset += scene->meshes[i].vertices.size();
-			index_offset += scene->meshes[i].indices.size();
+void load_meshes_and_textures_obj(
+	Scene* scene,
+	std::string obj_path,
+	std::string mtl_path,
+	bool compress_cache,
+	bool dedup_textures_by_content
+) {
+	/*
+	Import in stages: parse the obj file, read the materials, build all the
+	meshes, lay them out in the scene geometry, build the bvh and start
+	writing the cache in the background. Every stage runs once and reports
+	how long it took. When the cache is stale, only the meshes whose faces
+	or vertex attributes changed are built again.
+	*/
+
+	// use the cache if its sources didn't change, otherwise keep its geometry
+	// to reuse the meshes that didn't change
+	Timer timer;
+	std::string bin_path = obj_path.substr(0, obj_path.length() - 4) + ".bin";
+	SceneCacheInfo cached_info;
+	PreviousImport previous;
+
+	// the low bit tells if the images were merged by content, so turning it
+	// on or off imports again
+	uint32_t loader_version = OBJ_LOADER_VERSION * 2 + (dedup_textures_by_content ? 1 : 0);
+	if (std::filesystem::exists(bin_path) && read_scene_cache(scene, cached_info, bin_path)) {
+		bool fresh = cached_info.loader_version == loader_version && cached_info.sources.size() >= 2;
+		for (int i = 0; fresh && i < cached_info.sources.size(); i++) {
+			fresh = source_file_unchanged(cached_info.sources[i]);
 		}
-		vertex_offset = 0;
-		for (int i = 0; i < scene->meshes_with_normal_map.size(); i++) {
-			scene->meshes_with_normal_map[i].vertex_offset = vertex_offset;
-			scene->meshes_with_normal_map[i].index_offset = index_offset;
-			vertex_offset += scene->meshes_with_normal_map[i].vertices.size();
-			index_offset += scene->meshes_with_normal_map[i].indices.size();
+		if (fresh) {
+			std::cout << "loaded " << bin_path << " in " << timer.lap() << " ms" << std::endl;
+			return;
 		}
+		take_previous_import(scene, cached_info, previous);
+		std::cout << bin_path << " is out of date, importing again" << std::endl;
+	}
+
+	// remember what this import is built from
+	SceneCacheInfo info;
+	info.loader_version = loader_version;
+	info.sources.push_back(describe_source_file(obj_path));
+	info.sources.push_back(describe_source_file(mtl_path));
+
+	// parse the obj file
+	ObjData data;
+	parse_obj(obj_path, data);
+	for (int i = 0; i < data.groups.size(); i++) {
+		scene->debug_node_names.push_back(data.groups[i].debug_node_name);
+	}
+	double parse_time = timer.lap();
 
-		// serialize the model for faster loading next time
-		serialize(scene, bin_path);
+	// get folder path
+	std::filesystem::path file_path_ = std::filesystem::path(obj_path);
+	std::filesystem::path folder_path = file_path_.parent_path();
+
+	// load the textures and normal maps
+	std::vector<std::string> image_files;
+	std::unordered_map<std::string, std::pair<int, int>> material_mapping =
+		load_materials(scene, mtl_path, folder_path, dedup_textures_by_content, image_files);
+	double material_time = timer.lap();
+
+	// images merged by their contents have to be merged again when any of
+	// them changes, the dropped ones included
+	for (const std::string& image_file : image_files) info.sources.push_back(describe_source_file(image_file));
+
+	// create meshes
+	std::vector<MeshSlot> slots = build_meshes(scene, data, material_mapping, previous);
+	double build_time = timer.lap();
+	int num_reused = 0;
+	info.mesh_signatures.resize(slots.size());
+	for (int i = 0; i < slots.size(); i++) {
+		int mesh = slots[i].normal_map_index == -1 ? slots[i].mesh : scene->meshes.size() + slots[i].mesh;
+		info.mesh_signatures[mesh] = slots[i].signature;
+		if (slots[i].reused) num_reused++;
 	}
+
+	// update offsets and move the meshes into the scene geometry
+	assign_mesh_offsets(scene);
+	pack_mesh_geometry(scene, slots);
+	double offset_time = timer.lap();
+
+	// the bvh over the meshes and their triangles, cached with them
+	build_scene_bvh(scene);
+	double bvh_time = timer.lap();
+
+	// cache the scene for faster loading next time, only the snapshot of the
+	// scene is taken here
+	start_scene_cache_write(scene, info, bin_path, compress_cache);
+	double serialize_time = timer.lap();
+
+	std::cout << "imported " << obj_path << ": parse " << parse_time << " ms, materials "
+		<< material_time << " ms, meshes " << build_time << " ms, layout " << offset_time
+		<< " ms, bvh " << bvh_time << " ms, cache snapshot " << serialize_time << " ms, reused " << num_reused << " of "
+		<< slots.size() << " meshes" << std::endl;
 }
\ No newline at end of file
@@ -30,6 +30,17 @@
 #include "render_pass.h"
 #include "sm_math.h"
 #include "scene.h"
+#include "scene_bvh.h"
+#include "scene_cache.h"
+#include "texture_cache.h"
+#include "texture_residency.h"
+#include "draw_list.h"
+#include "frustum_culling.h"
+#include "occlusion_culling.h"
+#include "staging_ring.h"
+#include "image_loader.h"
+#include "parallel.h"
+#include "timer.h"
 #include "pipeline.h"
 #include "imgui.h"
 #include <backends/imgui_impl_glfw.h>
@@ -38,6 +49,11 @@
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
+// the perspective of the camera, the field of view is vertical in degrees
+const float fieldOfView = 45.0f;
+const float nearPlane = 0.1f;
+const float farPlane = 100.0f;
+
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
@@ -48,6 +64,57 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
+// store the scene cache geometry quantized and delta coded, smaller on disk
+// but the positions and normals are no longer exact
+const bool compressSceneCache = false;
+
+// block compress the textures to BC1/BC3 and the normal maps to BC5 when the
+// device supports it, a quarter to an eighth of the memory of rgba8
+const bool compressTextures = true;
+
+// also merge the textures whose files have the same contents, not only the
+// ones with the same path
+const bool dedupTexturesByContent = true;
+
+// all the uploads stream through a staging ring of this size, so the staging
+// memory doesn't grow with the scene
+const VkDeviceSize stagingRingSize = 128 << 20;
+
+// start the textures and normal maps at small mip levels and stream the
+// finer levels in as the visible meshes need them, under a memory budget with
+// the least recently used images evicted first, instead of keeping every
+// image whole from startup
+const bool streamTextures = true;
+const VkDeviceSize textureBudget = 256 << 20;
+const VkDeviceSize streamingUploadPerFrame = 16 << 20;
+
+// the most textures and normal maps the texture table can hold, the
+// descriptor pool is sized for this many whatever the scene has
+const uint32_t maxTableTextures = 4096;
+
+// submit the draws of each pipeline with one indirect call when the device
+// supports multi draw indirect, instead of a draw call per mesh sorted front
+// to back
+const bool indirectDraws = true;
+
+// cull the draws on the GPU against the frustum and a depth pyramid of the
+// frame, drawing in an early and a late pass, when the device can draw a
+// count of indirect commands written by the GPU
+const bool gpuCulling = true;
+
+// without culling on the GPU, test the bounds of the draws against the
+// frustum on the CPU before recording and only record the visible ones
+const bool cpuFrustumCulling = true;
+
+// cull on the CPU through the bvh of the scene, accepting or rejecting whole
+// subtrees of meshes at once, instead of testing every draw eight at a time
+const bool bvhFrustumCulling = false;
+
+// keep the camera this far from the triangles of the scene, without it the
+// camera moves through them
+const bool cameraCollision = true;
+const float cameraRadius = 0.2f;
+
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
     auto func = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
     if (func != nullptr) {
@@ -67,10 +134,17 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 class Application {
 public:
     void run() {
+        Timer timer;
         initWindow();
         initVulkan();
+        startupPhases.push_back({ "vulkan", timer.lap() });
         loadScene();
+
+        // the scene records its own phases
+        timer.lap();
         initImGui();
+        startupPhases.push_back({ "imgui", timer.lap() });
+        reportStartupPhases(timer.total());
         mainLoop();
         cleanup();
     }
@@ -88,6 +162,10 @@ private:
 
     RenderPass* renderPass;
 
+    // the passes of a frame drawn with culling on the GPU
+    RenderPass* earlyRenderPass = nullptr;
+    RenderPass* lateRenderPass = nullptr;
+
     VkSwapchainKHR swapChain;
     std::vector<VkImage> swapChainImages;
     VkFormat swapChainImageFormat;
@@ -97,20 +175,105 @@ private:
 
     VkDescriptorSetLayout descriptorSetLayout_0, descriptorSetLayout_1,
         descriptorSetLayout_2;
+
+    // the size of the texture table layout, the sets are allocated with as
+    // many elements as the scene has images
+    uint32_t textureTableSize;
     
     Pipeline basic_graphic_pipeline, basic_t_graphic_pipeline, normal_mapping_pipeline;
 
     Scene* scene;
 
+    // the cooked textures of the scene
+    std::string textureCacheDirectory;
+
+    StagingRing* stagingRing;
+
+    // how long each phase of the startup took in ms
+    std::vector<std::pair<std::string, double>> startupPhases;
+
     std::vector<VkImage> textureImage;
     std::vector<VkImageView> textureImageView;
+    std::vector<uint32_t> textureMipLevels;
+    std::vector<VkFormat> textureFormats;
     VkDeviceMemory textureImageMemory;
     VkSampler textureSampler;
+    VkSampler baseLevelSampler;
+    bool enableMipmaps = true;
 
     std::vector<VkImage> normalMapImage;
     std::vector<VkImageView> normalMapImageView;
+    std::vector<uint32_t> normalMapMipLevels;
+    std::vector<VkFormat> normalMapFormats;
     VkDeviceMemory normalMapImageMemory;
 
+    // an image whose mip levels are streamed, with the whole chain it was
+    // planned with and the image that holds its resident levels in memory
+    // of its own. The textures come first, then the normal maps.
+    struct StreamedImage {
+        ImageSlot slot;
+        int numChannels;
+        bool srgb;
+        VkFormat format;
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView view;
+
+        // where it is in the texture table, and a bit for every frame whose
+        // table still points at an older image
+        int tableIndex;
+        uint32_t staleFrames;
+    };
+
+    // an image that was replaced, destroyed once no frame in flight uses it
+    struct RetiredImage {
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView view;
+        uint64_t frame;
+    };
+
+    TextureResidency* residency;
+    std::vector<StreamedImage> streamedImages;
+    std::vector<RetiredImage> retiredImages;
+    std::vector<MeshFootprint> meshFootprints;
+    std::vector<MeshFootprint> meshWithNormalMapFootprints;
+    int textureBudgetMB = static_cast<int>(textureBudget >> 20);
+    uint64_t frameNumber = 0;
+
+    // the draws sorted every frame, and what recording them cost
+    DrawList drawList;
+    DrawStats drawStats = {};
+
+    // the draw data the shaders look up by instance index, the indirect
+    // commands of the draws in load order, and the number of draws of each
+    // pipeline range
+    Buffer* drawDataBuffer;
+    Buffer* indirectBuffer;
+    Buffer* drawCountBuffer;
+
+    // whether the device can cull the draws on the GPU, and the culling if
+    // the scene has few enough draws for it
+    bool cullOnGpu = false;
+    OcclusionCulling* culling = nullptr;
+
+    // the culling on the CPU: whether each draw is visible this frame, the
+    // commands of all the draws, and the commands of the visible draws of
+    // every frame in flight compacted in their pipeline ranges
+    FrustumCuller frustumCuller;
+    std::vector<uint8_t> drawVisible;
+    std::vector<uint8_t> meshVisible;
+    uint32_t drawsCulled = 0;
+    uint32_t cullNodesVisited = 0;
+    std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+    std::vector<Buffer*> visibleCommandBuffers;
+    std::vector<VkDrawIndexedIndirectCommand*> visibleCommands;
+    uint32_t visibleCounts[2] = {};
+    double frustumCullTime = 0.0;
+
+    // the mesh under the cursor when it was last clicked in debug mode
+    std::string pickedName;
+
     FragmentUniform fubo;
 
     VkImage depthImage;
@@ -143,28 +306,6 @@ private:
         // awsd to move around
         scene->camera.awsd_movement(window);
 
-        // press n to change the debug index to the next
-        if (glfwGetKey(window, GLFW_KEY_N) == GLFW_RELEASE) {
-            if (scene->debug_press_n) {
-                scene->debug_press_n = false;
-                scene->debug_index++;
-                if (scene->debug_index == scene->debug_node_names.size())
-                    scene->debug_index = 0;
-                std::cout << scene->debug_node_names[scene->debug_index] << std::endl;
-            }
-        } else if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) scene->debug_press_n = true;
-
-        // press b to change the debug index back
-        if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE) {
-            if (scene->debug_press_b) {
-                scene->debug_press_b = false;
-                scene->debug_index--;
-                if (scene->debug_index == -1)
-                    scene->debug_index = scene->debug_node_names.size() - 1;
-                std::cout << scene->debug_node_names[scene->debug_index] << std::endl;
-            }
-        } else if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) scene->debug_press_b = true;
-
         // press t to toggle debug mode
         if (glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE) {
             if (scene->debug_press_t) {
@@ -175,6 +316,40 @@ private:
         } else if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) scene->debug_press_t = true;
     }
 
+    void processPicking(GLFWwindow* window) {
+        /*
+        in debug mode, click a mesh to make it the debug index
+        */
+
+        // a click on the options window is not a pick
+        bool pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        if (pressed && !ImGui::GetIO().WantCaptureMouse) scene->debug_press_pick = true;
+        if (pressed || !scene->debug_press_pick) return;
+        scene->debug_press_pick = false;
+
+        // the ray from the eye through the cursor, the depths of the two
+        // points don't matter as long as they differ
+        double x, y;
+        int width, height;
+        glfwGetCursorPos(window, &x, &y);
+        glfwGetWindowSize(window, &width, &height);
+        if (width == 0 || height == 0) return;
+        glm::vec2 ndc(2.0f * x / width - 1.0f, 2.0f * y / height - 1.0f);
+        glm::mat4 inverse = glm::inverse(projectionMatrix() * viewMatrix());
+        glm::vec4 nearPoint = inverse * glm::vec4(ndc.x, ndc.y, 0.0f, 1.0f);
+        glm::vec4 farPoint = inverse * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+        glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - glm::vec3(nearPoint) / nearPoint.w);
+
+        RayHit hit;
+        if (!intersect_scene(*scene, Ray(scene->camera.cameraPos, direction), farPlane, hit)) {
+            pickedName = "";
+            return;
+        }
+        pickedName = scene_mesh(*scene, hit.mesh).debug_node_name;
+        auto name = std::find(scene->debug_node_names.begin(), scene->debug_node_names.end(), pickedName);
+        if (name != scene->debug_node_names.end()) scene->debug_index = name - scene->debug_node_names.begin();
+    }
+
     void initImGui() {
         ImGui::CreateContext();
         ImGui_ImplGlfw_InitForVulkan(window, true);
@@ -225,27 +400,28 @@ private:
     void create_graphic_pipelines() {
         createDescriptorSetLayout();
 
+        // every pipeline has the global uniforms, the texture table and the
+        // draw data, so switching pipelines keeps everything bound
         std::vector<VkDescriptorSetLayout> setLayouts =
             { descriptorSetLayout_0, descriptorSetLayout_1, descriptorSetLayout_2 };
+        std::vector<VkPushConstantRange> pushConstantRanges;
 
         // create the basic pipeline to render basic meshes
         basic_graphic_pipeline.create(&gpu, msaa, renderPass->getRenderPass(),
             "shaders/shader.vert.spv", "shaders/shader.frag.spv", Vertex::getBindingDescription(),
-            Vertex::getAttributeDescriptions(), setLayouts);
+            Vertex::getAttributeDescriptions(), setLayouts, pushConstantRanges);
 
         // create a graphic pipeline that takes vertex with tangent
         // and render it without normal mapping
         basic_t_graphic_pipeline.create(&gpu, msaa, renderPass->getRenderPass(),
             "shaders/shader_t.vert.spv", "shaders/shader.frag.spv", VertexWithTangent::getBindingDescription(),
-            VertexWithTangent::getAttributeDescriptions(), setLayouts);
+            VertexWithTangent::getAttributeDescriptions(), setLayouts, pushConstantRanges);
 
         // create normal mapping pipeline
-        setLayouts[2] = descriptorSetLayout_1;
-        setLayouts.push_back(descriptorSetLayout_2);
         normal_mapping_pipeline.create(&gpu, msaa, renderPass->getRenderPass(),
             "shaders/normal_mapping.vert.spv", "shaders/normal_mapping.frag.spv",
             VertexWithTangent::getBindingDescription(),
-            VertexWithTangent::getAttributeDescriptions(), setLayouts);
+            VertexWithTangent::getAttributeDescriptions(), setLayouts, pushConstantRanges);
     }
 
     void initVulkan() {
@@ -255,7 +431,14 @@ private:
         gpu = GPU(instance, surface);
         createSwapChain();
         msaa = new MSAA(&gpu, swapChainImageFormat, swapChainExtent);
+        cullOnGpu = gpuCulling && gpu.multiDrawIndirect && gpu.cmdDrawIndexedIndirectCount != nullptr;
         renderPass = new RenderPass(gpu.logical_gpu, swapChainImageFormat, findDepthFormat(), msaa->getSampleCount());
+        if (cullOnGpu) {
+            earlyRenderPass = new RenderPass(gpu.logical_gpu, swapChainImageFormat, findDepthFormat(),
+                msaa->getSampleCount(), RENDER_PASS_EARLY);
+            lateRenderPass = new RenderPass(gpu.logical_gpu, swapChainImageFormat, findDepthFormat(),
+                msaa->getSampleCount(), RENDER_PASS_LATE);
+        }
         create_graphic_pipelines();
         createDepthResources();
         createFramebuffers();
@@ -266,34 +449,75 @@ private:
 
     void loadScene() {
 
+        Timer timer;
         scene = new Scene();
         load_meshes_and_textures_obj(
             scene,
             "3d_models/San_Miguel/san-miguel-low-poly.obj",
-            "3d_models/San_Miguel/san-miguel-low-poly.mtl"
+            "3d_models/San_Miguel/san-miguel-low-poly.mtl",
+            compressSceneCache,
+            dedupTexturesByContent
         );
+        textureCacheDirectory = "3d_models/San_Miguel/texture_cache";
         scene->debug_index = 0;
-        scene->debug_press_n = false;
-        scene->debug_press_b = false;
+        scene->debug_press_pick = false;
         scene->debug_press_t = false;
         scene->debug_mode = false;
         scene->enable_normal_map = false;
         scene->lights = light();
         scene->lights.load_file("config/all_lights.txt");
+        if (cameraCollision) {
+            scene->camera.collide = [this](glm::vec3 from, glm::vec3 to) {
+                return collide_movement(*scene, from, to, cameraRadius);
+            };
+        }
         fubo.lights = scene->lights;
+        startupPhases.push_back({ "scene", timer.lap() });
 
         // create VkImage and VkImageView for textures
+        stagingRing = new StagingRing(&gpu, stagingRingSize);
+        computeMeshFootprints();
+        drawList.build(*scene);
+        if (streamTextures) residency = new TextureResidency(textureBudget, streamingUploadPerFrame);
         createTextureImages();
-        createTextureImageViews();
+        if (!streamTextures) createTextureImageViews();
 
         // create VkImage and VkImageView for normal maps
         createNormalMapImages();
+        if (streamTextures) {
+            std::cout << "textures and normal maps start with " << residency->resident_bytes / 1048576.0 << " MB of "
+                << residency->whole_bytes / 1048576.0 << " MB resident, budget " << textureBudget / 1048576.0 << " MB" << std::endl;
+        }
 
-        scene->createVertexBuffer(&gpu);
-        scene->createIndexBuffer(&gpu);
+        // the images record their own phases
+        timer.lap();
+        scene->createVertexBuffer(&gpu, stagingRing);
+        scene->createIndexBuffer(&gpu, stagingRing);
+        createDrawBuffers();
+
+        // the count of culled draws of a range is read in one indirect call
+        if (cullOnGpu && drawList.draws.size() <= gpu.maxDrawIndirectCount) {
+            culling = new OcclusionCulling(&gpu, drawList, indirectBuffer, stagingRing);
+            culling->createPyramid(depthImageView, swapChainExtent, msaa->getSampleCount());
+        }
+        startupPhases.push_back({ "geometry upload", timer.lap() });
+
+        // wait for the GPU to finish the uploads
+        stagingRing->flush();
+        startupPhases.push_back({ "upload wait", timer.lap() });
+        std::cout << "uploaded " << stagingRing->bytes_uploaded / 1048576.0 << " MB through a "
+            << stagingRingSize / 1048576.0 << " MB staging ring in " << stagingRing->num_submits << " submits" << std::endl;
         scene->createUniformBuffer(&gpu);
         createDescriptorPool();
         createDescriptorSets();
+        startupPhases.push_back({ "descriptors", timer.lap() });
+    }
+
+    void reportStartupPhases(double total) {
+        std::cout << "startup took " << total << " ms:" << std::endl;
+        for (const auto& phase : startupPhases) {
+            std::cout << "  " << phase.first << " " << phase.second << " ms" << std::endl;
+        }
     }
 
     void mainLoop() {
@@ -310,6 +534,7 @@ private:
                 if (glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED) {
                     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
                 }
+                processPicking(window);
             }
 
             glfwPollEvents();
@@ -324,6 +549,40 @@ private:
                 ImGui::Begin("Options");
                 ImGui::Checkbox("Debug mode", &scene->debug_mode);
                 ImGui::Checkbox("Normal map", &scene->enable_normal_map);
+                if (ImGui::Checkbox("Mipmaps", &enableMipmaps)) {
+
+                    // the descriptor sets may still be used by frames in flight
+                    vkDeviceWaitIdle(gpu.logical_gpu);
+                    writeDescriptorSets();
+                }
+                if (streamTextures) {
+                    ImGui::SliderInt("Texture budget (MB)", &textureBudgetMB, 16, 4096);
+                    residency->budget = VkDeviceSize(textureBudgetMB) << 20;
+                    ImGui::Text("%.1f of %.1f MB resident", residency->resident_bytes / 1048576.0,
+                        residency->whole_bytes / 1048576.0);
+                    ImGui::Text("backlog %d images, %.1f MB", residency->backlog_size, residency->backlog_bytes / 1048576.0);
+                    ImGui::Text("streamed in %d, evicted %d, %.1f MB uploaded", residency->num_streamed_in,
+                        residency->num_evicted, residency->bytes_streamed / 1048576.0);
+                }
+                ImGui::Text("%d draws in %d materials, %d draw calls, %d pipeline binds, %d descriptor binds",
+                    drawStats.draws, drawList.num_buckets, drawStats.draw_calls, drawStats.pipeline_binds,
+                    drawStats.descriptor_binds);
+                if (cpuFrustumCulling && culling == nullptr) {
+                    if (bvhFrustumCulling) {
+                        ImGui::Text("frustum culled %u of %zu draws in %.3f ms, visited %u bvh nodes", drawsCulled,
+                            drawVisible.size(), frustumCullTime, cullNodesVisited);
+                    } else {
+                        ImGui::Text("frustum culled %.1f%% of %u draws in %.3f ms", frustumCuller.culledPercent(),
+                            frustumCuller.num_tested, frustumCullTime);
+                    }
+                }
+                if (culling != nullptr) {
+                    ImGui::Checkbox("Occlusion culling", &culling->occlusion);
+                    ImGui::Text("tested %u, frustum culled %u, occlusion culled %u, drawn %u", culling->stats.tested,
+                        culling->stats.frustum_culled, culling->stats.occlusion_culled, culling->stats.drawn);
+                }
+                ImGui::Text("picked: %s", pickedName.empty() ? "nothing, click a mesh" : pickedName.c_str());
+                ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
                 ImGui::End();
             }
 
@@ -340,6 +599,8 @@ private:
     void cleanupSwapChain() {
         msaa->destroyColorResources();
 
+        if (culling != nullptr) culling->destroyPyramid();
+
         vkDestroyImageView(gpu.logical_gpu, depthImageView, nullptr);
         vkDestroyImage(gpu.logical_gpu, depthImage, nullptr);
         vkFreeMemory(gpu.logical_gpu, depthImageMemory, nullptr);
@@ -357,6 +618,9 @@ private:
 
     void cleanup() {
 
+        // let the scene cache finish writing
+        finish_scene_cache_write();
+
         // clean up imgui
         ImGui_ImplVulkan_Shutdown();
         ImGui_ImplGlfw_Shutdown();
@@ -365,6 +629,7 @@ private:
         cleanupSwapChain();
 
         vkDestroySampler(gpu.logical_gpu, textureSampler, nullptr);
+        vkDestroySampler(gpu.logical_gpu, baseLevelSampler, nullptr);
 
         // destroy the VkImage and VkImageView
         for (int i = 0; i < scene->textures.size(); i++) {
@@ -376,13 +641,30 @@ private:
             vkDestroyImage(gpu.logical_gpu, normalMapImage[i], nullptr);
         }
         
-        vkFreeMemory(gpu.logical_gpu, textureImageMemory, nullptr);
-        vkFreeMemory(gpu.logical_gpu, normalMapImageMemory, nullptr);
+        if (streamTextures) {
+            for (const StreamedImage& streamed : streamedImages) vkFreeMemory(gpu.logical_gpu, streamed.memory, nullptr);
+            destroyRetiredImages(UINT64_MAX);
+            delete residency;
+        } else {
+            vkFreeMemory(gpu.logical_gpu, textureImageMemory, nullptr);
+            vkFreeMemory(gpu.logical_gpu, normalMapImageMemory, nullptr);
+        }
 
         delete msaa;
 
+        delete stagingRing;
+
         delete scene;
 
+        delete drawDataBuffer;
+        delete indirectBuffer;
+        delete drawCountBuffer;
+        delete culling;
+        for (Buffer* buffer : visibleCommandBuffers) {
+            vkUnmapMemory(gpu.logical_gpu, buffer->memory);
+            delete buffer;
+        }
+
         vkDestroyDescriptorPool(gpu.logical_gpu, descriptorPool, nullptr);
 
         vkDestroyDescriptorSetLayout(gpu.logical_gpu, descriptorSetLayout_0, nullptr);
@@ -397,6 +679,8 @@ private:
         vkDestroyPipelineLayout(gpu.logical_gpu, normal_mapping_pipeline.layout, nullptr);
 
         delete renderPass;
+        delete earlyRenderPass;
+        delete lateRenderPass;
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             vkDestroySemaphore(gpu.logical_gpu, renderFinishedSemaphores[i], nullptr);
@@ -435,6 +719,7 @@ private:
         createImageViews();
         msaa->createColorResources(swapChainImageFormat, swapChainExtent);
         createDepthResources();
+        if (culling != nullptr) culling->createPyramid(depthImageView, swapChainExtent, msaa->getSampleCount());
         createFramebuffers();
     }
 
@@ -475,69 +760,48 @@ private:
         Load images from files and create texture images
         */
 
-        // image size
-        VkDeviceSize totalImageSize = 0;
-        std::vector<VkDeviceSize> imageSize;
-        imageSize.resize(scene->textures.size());
-        std::vector<int> texWidth;
-        texWidth.resize(scene->textures.size());
-        std::vector<int> texHeight;
-        texHeight.resize(scene->textures.size());
-
-        // image data
-        std::vector<stbi_uc*> pixels;
-        pixels.resize(scene->textures.size());
-
-        // load images from files
-        for (int i = 0; i < scene->textures.size(); i++) {
-            
-            // load the image using stb library
-            int texChannels;
-            pixels[i] = stbi_load(scene->textures[i].file_path.c_str(),
-                &texWidth[i], &texHeight[i], &texChannels, STBI_rgb_alpha);
-            if (!pixels[i]) throw std::runtime_error("failed to load texture image!");
-
-            // calculate image size
-            imageSize[i] = texWidth[i] * texHeight[i] * 4;
-            totalImageSize += imageSize[i];
-        }
-
-        // create staging buffer
-        Buffer staging_buffer(&gpu, totalImageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-        // map the staging buffer memory on the GPU to a memory block on the RAM
-        void* data;
-        vkMapMemory(gpu.logical_gpu, staging_buffer.memory, 0, totalImageSize, 0, &data);
-
-        // copy the image data to the mapped memory
-        int offset = 0;
-        for (int i = 0; i < scene->textures.size(); i++) {
-            
-            // flip the memory layout vertically so that it can map correctly
-            for (int j = 0; j < texHeight[i]; j++) {
-                memcpy((char*)data + offset + j * texWidth[i] * 4, pixels[i] + (texHeight[i] - 1 - j) * texWidth[i] * 4, texWidth[i] * 4);
-            }
-
-            // free the loaded image data
-            stbi_image_free(pixels[i]);
-
-            // update the offset
-            offset += imageSize[i];
+        // block compressed and streamed images get their whole mip chain
+        // from the CPU, otherwise blit the mip chain on the GPU if it can
+        // filter the format, else build it on the CPU
+        ImageEncoding encoding = compressTextures && gpu.textureCompressionBC ? ENCODING_COLOR_BC : ENCODING_RAW;
+        bool gpuMipmaps = !streamTextures && encoding == ENCODING_RAW && supportsLinearBlit(VK_FORMAT_R8G8B8A8_SRGB);
+
+        // lay out the mip levels of every image
+        std::vector<std::string> filePaths;
+        for (int i = 0; i < scene->textures.size(); i++) filePaths.push_back(scene->textures[i].file_path);
+        uint64_t totalImageSize;
+        std::vector<ImageSlot> slots = plan_image_slots(filePaths, 4, encoding, !gpuMipmaps, totalImageSize);
+
+        // cook the images that are not in the texture cache yet, which also
+        // tells the block format of every image
+        Timer timer;
+        int numCached = cook_images(slots, 4, true, textureCacheDirectory);
+        double cookTime = timer.lap();
+        startupPhases.push_back({ "textures cook", cookTime });
+        report_decode_times("textures", slots, cookTime);
+        std::cout << numCached << " of " << slots.size() << " textures from the texture cache" << std::endl;
+        report_texture_memory("textures", slots, 4);
+
+        // streamed images start with their smallest levels
+        if (streamTextures) {
+            createStreamedImages(slots, 4, true, VK_FORMAT_R8G8B8A8_SRGB, 0, textureImage, textureImageView,
+                textureMipLevels, textureFormats);
+            startupPhases.push_back({ "textures upload", timer.lap() });
+            return;
         }
 
-        // After copy is complete, unmap the GPU memory
-        vkUnmapMemory(gpu.logical_gpu, staging_buffer.memory);
-
         // create the VkImages and get memory requirements
         textureImage.resize(scene->textures.size());
+        textureFormats.resize(scene->textures.size());
         std::vector<VkMemoryRequirements> memRequirements;
         memRequirements.resize(scene->textures.size());
         VkDeviceSize totalRequiredSize = 0;
         uint32_t typeFilter = UINT32_MAX;
         for (int i = 0; i < scene->textures.size(); i++) {
-            gpu.createImage(static_cast<uint32_t>(texWidth[i]), static_cast<uint32_t>(texHeight[i]), VK_SAMPLE_COUNT_1_BIT,
-                VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, textureImage[i]);
+            textureFormats[i] = imageFormat(slots[i].format, VK_FORMAT_R8G8B8A8_SRGB);
+            gpu.createImage(static_cast<uint32_t>(slots[i].width), static_cast<uint32_t>(slots[i].height), slots[i].mip_levels,
+                VK_SAMPLE_COUNT_1_BIT, textureFormats[i],
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, textureImage[i]);
             vkGetImageMemoryRequirements(gpu.logical_gpu, textureImage[i], &memRequirements[i]);
             totalRequiredSize += memRequirements[i].size;
             typeFilter &= memRequirements[i].memoryTypeBits;
@@ -552,28 +816,24 @@ private:
         std::vector<VkDeviceSize> imageOffset;
         calculate_offsets(imageOffset, memRequirements);
 
-        // bind the VkImage to the memory and copy data from the staging buffer to the VkImage
-        VkDeviceSize bufferOffset = 0;
+        // bind the VkImages to the memory and stream the images to them through
+        // the staging ring
         for (int i = 0; i < scene->textures.size(); i++) {
-            
-            // bind the VkImage
             vkBindImageMemory(gpu.logical_gpu, textureImage[i], textureImageMemory, imageOffset[i]);
-
-            // copy data
-            transitionImageLayout(textureImage[i], VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-            copyBufferToImage(staging_buffer.buffer, bufferOffset, textureImage[i],
-                static_cast<uint32_t>(texWidth[i]), static_cast<uint32_t>(texHeight[i]));
-            transitionImageLayout(textureImage[i], VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-            // update the offset
-            bufferOffset += imageSize[i];
         }
+        startupPhases.push_back({ "textures create", timer.lap() });
+        uploadImages(slots, 4, true, textureImage, gpuMipmaps);
+        startupPhases.push_back({ "textures upload", timer.lap() });
+
+        textureMipLevels.resize(scene->textures.size());
+        for (int i = 0; i < scene->textures.size(); i++) textureMipLevels[i] = slots[i].mip_levels;
     }
 
     void createTextureImageViews() {
         textureImageView.resize(scene->textures.size());
         for (int i = 0; i < scene->textures.size(); i++) {
-            textureImageView[i] = gpu.createImageView(textureImage[i], VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+            textureImageView[i] = gpu.createImageView(textureImage[i], textureFormats[i], VK_IMAGE_ASPECT_COLOR_BIT,
+                textureMipLevels[i]);
         }
     }
 
@@ -582,84 +842,59 @@ private:
         Load images from files and create normal map images
         */
 
-        // select the format of the images
+        // select the format of the uncompressed images, normal maps hold
+        // vectors and are not srgb
+        ImageEncoding encoding = compressTextures && gpu.textureCompressionBC ? ENCODING_NORMAL_BC : ENCODING_RAW;
         VkFormat format = findSupportedFormat(
-            { VK_FORMAT_R8G8B8_SRGB, VK_FORMAT_R8G8B8A8_SRGB },
+            { VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM },
             VK_IMAGE_TILING_OPTIMAL,
             VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT
         );
         int num_channels;
-        if (format == VK_FORMAT_R8G8B8_SRGB) num_channels = 3;
+        if (format == VK_FORMAT_R8G8B8_UNORM && encoding == ENCODING_RAW) num_channels = 3;
         else num_channels = 4;
 
-        // image size
-        VkDeviceSize totalImageSize = 0;
-        std::vector<VkDeviceSize> imageSize;
-        imageSize.resize(scene->normal_maps.size());
-        std::vector<int> texWidth;
-        texWidth.resize(scene->normal_maps.size());
-        std::vector<int> texHeight;
-        texHeight.resize(scene->normal_maps.size());
-
-        // image data
-        std::vector<stbi_uc*> pixels;
-        pixels.resize(scene->normal_maps.size());
-
-        // load images from files
-        for (int i = 0; i < scene->normal_maps.size(); i++) {
-
-            // load the image using stb library
-            int texChannels;
-            pixels[i] = stbi_load(scene->normal_maps[i].file_path.c_str(),
-                &texWidth[i], &texHeight[i], &texChannels, num_channels);
-            if (!pixels[i]) throw std::runtime_error("failed to load texture image!");
-
-            // calculate image size
-            imageSize[i] = texWidth[i] * texHeight[i] * num_channels;
-            totalImageSize += imageSize[i];
-
-        }
-
-        // create staging buffer
-        Buffer staging_buffer(&gpu, totalImageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-        // map the staging buffer memory on the GPU to a memory block on the RAM
-        void* data;
-        vkMapMemory(gpu.logical_gpu, staging_buffer.memory, 0, totalImageSize, 0, &data);
-
-        // copy the image data to the mapped memory
-        int offset = 0;
-        for (int i = 0; i < scene->normal_maps.size(); i++) {
-
-            // flip the memory layout vertically so that it can map correctly
-            for (int j = 0; j < texHeight[i]; j++) {
-                memcpy(
-                    (char*)data + offset + j * texWidth[i] * num_channels,
-                    pixels[i] + (texHeight[i] - 1 - j) * texWidth[i] * num_channels,
-                    texWidth[i] * num_channels
-                );
-            }
-
-            // free the loaded image data
-            stbi_image_free(pixels[i]);
-
-            // update the offset
-            offset += imageSize[i];
+        // block compressed and streamed images get their whole mip chain
+        // from the CPU, otherwise blit the mip chain on the GPU if it can
+        // filter the format, else build it on the CPU
+        bool gpuMipmaps = !streamTextures && encoding == ENCODING_RAW && supportsLinearBlit(format);
+
+        // lay out the mip levels of every image
+        std::vector<std::string> filePaths;
+        for (int i = 0; i < scene->normal_maps.size(); i++) filePaths.push_back(scene->normal_maps[i].file_path);
+        uint64_t totalImageSize;
+        std::vector<ImageSlot> slots = plan_image_slots(filePaths, num_channels, encoding, !gpuMipmaps, totalImageSize);
+
+        // cook the images that are not in the texture cache yet, which also
+        // tells the block format of every image
+        Timer timer;
+        int numCached = cook_images(slots, num_channels, false, textureCacheDirectory);
+        double cookTime = timer.lap();
+        startupPhases.push_back({ "normal maps cook", cookTime });
+        report_decode_times("normal maps", slots, cookTime);
+        std::cout << numCached << " of " << slots.size() << " normal maps from the texture cache" << std::endl;
+        report_texture_memory("normal maps", slots, num_channels);
+
+        // streamed images start with their smallest levels
+        if (streamTextures) {
+            createStreamedImages(slots, num_channels, false, format, static_cast<int>(scene->textures.size()),
+                normalMapImage, normalMapImageView, normalMapMipLevels, normalMapFormats);
+            startupPhases.push_back({ "normal maps upload", timer.lap() });
+            return;
         }
 
-        // After copy is complete, unmap the GPU memory
-        vkUnmapMemory(gpu.logical_gpu, staging_buffer.memory);
-
         // create the VkImages and get memory requirements
         normalMapImage.resize(scene->normal_maps.size());
+        normalMapFormats.resize(scene->normal_maps.size());
         std::vector<VkMemoryRequirements> memRequirements;
         memRequirements.resize(scene->normal_maps.size());
         VkDeviceSize totalRequiredSize = 0;
         uint32_t typeFilter = UINT32_MAX;
         for (int i = 0; i < scene->normal_maps.size(); i++) {
-            gpu.createImage(static_cast<uint32_t>(texWidth[i]), static_cast<uint32_t>(texHeight[i]), VK_SAMPLE_COUNT_1_BIT,
-                format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, normalMapImage[i]);
+            normalMapFormats[i] = imageFormat(slots[i].format, format);
+            gpu.createImage(static_cast<uint32_t>(slots[i].width), static_cast<uint32_t>(slots[i].height), slots[i].mip_levels,
+                VK_SAMPLE_COUNT_1_BIT, normalMapFormats[i],
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, normalMapImage[i]);
             vkGetImageMemoryRequirements(gpu.logical_gpu, normalMapImage[i], &memRequirements[i]);
             totalRequiredSize += memRequirements[i].size;
             typeFilter &= memRequirements[i].memoryTypeBits;
@@ -675,41 +910,289 @@ private:
         std::vector<VkDeviceSize> imageOffset;
         calculate_offsets(imageOffset, memRequirements);
 
-        // bind the VkImage to the memory and copy data from the staging buffer to the VkImage
-        VkDeviceSize bufferOffset = 0;
+        // bind the VkImages to the memory and stream the images to them through
+        // the staging ring
         for (int i = 0; i < scene->normal_maps.size(); i++) {
-
-            // bind the VkImage
             vkBindImageMemory(gpu.logical_gpu, normalMapImage[i], normalMapImageMemory, imageOffset[i]);
-
-            // copy data
-            transitionImageLayout(
-                normalMapImage[i],
-                format,
-                VK_IMAGE_LAYOUT_UNDEFINED,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-            );
-            copyBufferToImage(staging_buffer.buffer, bufferOffset, normalMapImage[i],
-                static_cast<uint32_t>(texWidth[i]), static_cast<uint32_t>(texHeight[i]));
-            transitionImageLayout(
-                normalMapImage[i],
-                format,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-            );
-
-            // update the offset
-            bufferOffset += imageSize[i];
         }
+        startupPhases.push_back({ "normal maps create", timer.lap() });
+        uploadImages(slots, num_channels, false, normalMapImage, gpuMipmaps);
+        startupPhases.push_back({ "normal maps upload", timer.lap() });
 
-        createNormalMapImageViews(format);
+        normalMapMipLevels.resize(scene->normal_maps.size());
+        for (int i = 0; i < scene->normal_maps.size(); i++) normalMapMipLevels[i] = slots[i].mip_levels;
+        createNormalMapImageViews();
     }
 
-    void createNormalMapImageViews(VkFormat format) {
+    void createNormalMapImageViews() {
         normalMapImageView.resize(scene->normal_maps.size());
         for (int i = 0; i < scene->normal_maps.size(); i++) {
-            normalMapImageView[i] = gpu.createImageView(normalMapImage[i], format, VK_IMAGE_ASPECT_COLOR_BIT);
+            normalMapImageView[i] = gpu.createImageView(normalMapImage[i], normalMapFormats[i], VK_IMAGE_ASPECT_COLOR_BIT,
+                normalMapMipLevels[i]);
+        }
+    }
+
+    void createStreamedImages(const std::vector<ImageSlot>& slots, int numChannels, bool srgb, VkFormat uncompressedFormat,
+        int tableOffset, std::vector<VkImage>& images, std::vector<VkImageView>& views,
+        std::vector<uint32_t>& mipLevels, std::vector<VkFormat>& formats) {
+        /*
+        Add the images to the residency and create them with only their
+        levels up to the residency floor, the finer levels are streamed in by
+        streamTextureLevels
+        */
+        std::vector<ImageSlot> levelSlots;
+        images.resize(slots.size());
+        views.resize(slots.size());
+        mipLevels.resize(slots.size());
+        formats.resize(slots.size());
+        for (int i = 0; i < slots.size(); i++) {
+            StreamedImage streamed;
+            streamed.slot = slots[i];
+            streamed.numChannels = numChannels;
+            streamed.srgb = srgb;
+            streamed.format = imageFormat(slots[i].format, uncompressedFormat);
+            streamed.tableIndex = tableOffset + i;
+            streamed.staleFrames = 0;
+
+            int index = residency->add_image(slots[i], numChannels);
+            uint32_t level = residency->floor_level(index);
+            levelSlots.push_back(image_slot_levels(slots[i], level));
+            residency->set_resident(index, level, createResidentImage(streamed, levelSlots.back()));
+            streamedImages.push_back(streamed);
+
+            images[i] = streamed.image;
+            views[i] = streamed.view;
+            mipLevels[i] = levelSlots.back().mip_levels;
+            formats[i] = streamed.format;
+        }
+        uploadImages(levelSlots, numChannels, srgb, images, false);
+    }
+
+    VkDeviceSize createResidentImage(StreamedImage& streamed, const ImageSlot& levels) {
+        /*
+        Create the image of the levels of a streamed image in memory of its
+        own, returns the size of the memory
+        */
+        gpu.createImage(static_cast<uint32_t>(levels.width), static_cast<uint32_t>(levels.height), levels.mip_levels,
+            VK_SAMPLE_COUNT_1_BIT, streamed.format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            streamed.image);
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(gpu.logical_gpu, streamed.image, &memRequirements);
+        gpu.allocateMemory(memRequirements.size,
+            gpu.findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+            streamed.memory);
+        vkBindImageMemory(gpu.logical_gpu, streamed.image, streamed.memory, 0);
+        streamed.view = gpu.createImageView(streamed.image, streamed.format, VK_IMAGE_ASPECT_COLOR_BIT, levels.mip_levels);
+        return memRequirements.size;
+    }
+
+    VkFormat imageFormat(BlockFormat blockFormat, VkFormat uncompressedFormat) {
+        /*
+        The Vulkan format of an image decoded to a block format, srgb unless
+        it is a normal map
+        */
+        switch (blockFormat) {
+        case BLOCK_BC1: return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+        case BLOCK_BC3: return VK_FORMAT_BC3_SRGB_BLOCK;
+        case BLOCK_BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+        default: return uncompressedFormat;
+        }
+    }
+
+    bool supportsLinearBlit(VkFormat format) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(gpu.physical_gpu, format, &properties);
+        VkFormatFeatureFlags features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        return (properties.optimalTilingFeatures & features) == features;
+    }
+
+    void uploadImages(std::vector<ImageSlot>& slots, int numChannels, bool srgb, const std::vector<VkImage>& images,
+        bool gpuMipmaps) {
+        /*
+        Stream the images through the staging ring. As many images as fit in
+        the current region are read on all the cores at once, then the copies
+        out of the region are recorded. An image larger than a region goes
+        through the ring in bands of rows.
+        */
+        int i = 0;
+        while (i < slots.size()) {
+            std::vector<int> batch;
+            std::vector<StagingSpan> spans;
+            StagingSpan span;
+            while (i < slots.size() && slots[i].size <= stagingRing->region_size &&
+                stagingRing->allocate(slots[i].size, IMAGE_SLOT_ALIGNMENT, span)) {
+                batch.push_back(i);
+                spans.push_back(span);
+                i++;
+            }
+
+            if (!batch.empty()) {
+                parallel_for(batch.size(), [&](int k) {
+                    read_image(slots[batch[k]], numChannels, srgb, spans[k].data);
+                });
+                uploadImageBatch(slots, images, batch, spans, gpuMipmaps);
+            } else if (slots[i].size > stagingRing->region_size) {
+                uploadLargeImage(slots[i], numChannels, srgb, images[i], gpuMipmaps);
+                i++;
+            } else {
+                stagingRing->submit();
+            }
+        }
+    }
+
+    void uploadImageBatch(const std::vector<ImageSlot>& slots, const std::vector<VkImage>& images,
+        const std::vector<int>& batch, const std::vector<StagingSpan>& spans, bool gpuMipmaps) {
+        /*
+        Record the upload of a batch of images in the current region of the
+        staging ring: one barrier for all the images, one copy of all the
+        levels of each image, and one barrier that leaves all the images ready
+        for the shaders, or the mip blits
+        */
+        VkCommandBuffer commandBuffer = stagingRing->commandBuffer();
+        std::vector<VkImage> batchImages;
+        std::vector<uint32_t> batchMipLevels;
+        for (int i : batch) {
+            batchImages.push_back(images[i]);
+            batchMipLevels.push_back(slots[i].mip_levels);
+        }
+        transitionImageLayouts(commandBuffer, batchImages, batchMipLevels, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        for (int k = 0; k < batch.size(); k++) {
+            const ImageSlot& slot = slots[batch[k]];
+            std::vector<VkBufferImageCopy> regions;
+            uint32_t width = slot.width;
+            uint32_t height = slot.height;
+            for (uint32_t level = 0; level < slot.level_offsets.size(); level++) {
+                regions.push_back(imageCopyRegion(spans[k].offset + slot.level_offsets[level] - slot.offset,
+                    level, 0, width, height));
+                width = std::max(width / 2, 1u);
+                height = std::max(height / 2, 1u);
+            }
+            vkCmdCopyBufferToImage(commandBuffer, stagingRing->buffer->buffer, batchImages[k],
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+        }
+
+        if (gpuMipmaps) {
+            for (int i : batch) generateMipmaps(commandBuffer, images[i], slots[i].width, slots[i].height, slots[i].mip_levels);
+        } else {
+            transitionImageLayouts(commandBuffer, batchImages, batchMipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
+    }
+
+    void uploadLargeImage(ImageSlot& slot, int numChannels, bool srgb, VkImage image, bool gpuMipmaps) {
+        /*
+        Read an image that doesn't fit in a region into memory and copy every
+        level in bands of rows, whole rows of blocks if it is block compressed
+        */
+        std::vector<char> pixels(slot.size);
+        read_image(slot, numChannels, srgb, pixels.data());
+
+        transitionImageLayouts(stagingRing->commandBuffer(), { image }, { slot.mip_levels }, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        uint32_t rowHeight = slot.format == BLOCK_NONE ? 1 : 4;
+        uint32_t width = slot.width;
+        uint32_t height = slot.height;
+        for (uint32_t level = 0; level < slot.level_offsets.size(); level++) {
+            const char* levelPixels = pixels.data() + slot.level_offsets[level] - slot.offset;
+            VkDeviceSize rowSize = slot.format == BLOCK_NONE ? VkDeviceSize(width) * numChannels :
+                VkDeviceSize((width + 3) / 4) * block_bytes(slot.format);
+            uint32_t numRows = (height + rowHeight - 1) / rowHeight;
+            uint32_t bandRows = static_cast<uint32_t>(std::min<VkDeviceSize>(stagingRing->region_size / rowSize, numRows));
+            if (bandRows == 0) throw std::runtime_error("failed to upload texture image " + slot.file_path + ", a row is larger than the staging ring");
+            for (uint32_t row = 0; row < numRows; row += bandRows) {
+                uint32_t rows = std::min(bandRows, numRows - row);
+                StagingSpan span;
+                if (!stagingRing->allocate(rows * rowSize, IMAGE_SLOT_ALIGNMENT, span)) {
+                    stagingRing->submit();
+                    stagingRing->allocate(rows * rowSize, IMAGE_SLOT_ALIGNMENT, span);
+                }
+                memcpy(span.data, levelPixels + row * rowSize, rows * rowSize);
+                VkBufferImageCopy region = imageCopyRegion(span.offset, level, row * rowHeight, width,
+                    std::min(rows * rowHeight, height - row * rowHeight));
+                vkCmdCopyBufferToImage(stagingRing->commandBuffer(), stagingRing->buffer->buffer, image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+            }
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
         }
+        VkCommandBuffer commandBuffer = stagingRing->commandBuffer();
+        if (gpuMipmaps) {
+            generateMipmaps(commandBuffer, image, slot.width, slot.height, slot.mip_levels);
+        } else {
+            transitionImageLayouts(commandBuffer, { image }, { slot.mip_levels }, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
+    }
+
+    void generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t width, int32_t height, uint32_t mipLevels) {
+        /*
+        Blit every mip level to the next smaller one, all the levels start in
+        TRANSFER_DST_OPTIMAL and end in SHADER_READ_ONLY_OPTIMAL
+        */
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.image = image;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.subresourceRange.levelCount = 1;
+
+        for (uint32_t i = 1; i < mipLevels; i++) {
+            int32_t nextWidth = std::max(width / 2, 1);
+            int32_t nextHeight = std::max(height / 2, 1);
+
+            // the previous level becomes the source of the blit
+            barrier.subresourceRange.baseMipLevel = i - 1;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkImageBlit blit{};
+            blit.srcOffsets[0] = { 0, 0, 0 };
+            blit.srcOffsets[1] = { width, height, 1 };
+            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.srcSubresource.mipLevel = i - 1;
+            blit.srcSubresource.baseArrayLayer = 0;
+            blit.srcSubresource.layerCount = 1;
+            blit.dstOffsets[0] = { 0, 0, 0 };
+            blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.dstSubresource.mipLevel = i;
+            blit.dstSubresource.baseArrayLayer = 0;
+            blit.dstSubresource.layerCount = 1;
+            vkCmdBlitImage(commandBuffer,
+                image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1, &blit, VK_FILTER_LINEAR);
+
+            // the previous level is done
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                0, nullptr, 0, nullptr, 1, &barrier);
+
+            width = nextWidth;
+            height = nextHeight;
+        }
+
+        // the last level was only written to
+        barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &barrier);
     }
 
     void createTextureSampler() {
@@ -729,10 +1212,16 @@ private:
         samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         samplerInfo.mipLodBias = 0.0f;
         samplerInfo.minLod = 0.0f;
-        samplerInfo.maxLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
         if (vkCreateSampler(gpu.logical_gpu, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
             throw std::runtime_error("failed to create texture sampler!");
         }
+
+        // the same sampler without the mip chain, to compare against
+        samplerInfo.maxLod = 0.0f;
+        if (vkCreateSampler(gpu.logical_gpu, &samplerInfo, nullptr, &baseLevelSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture sampler!");
+        }
     }
 
     void createInstance() {
@@ -857,7 +1346,7 @@ private:
         swapChainImageViews.resize(swapChainImages.size());
 
         for (size_t i = 0; i < swapChainImages.size(); i++) {
-            swapChainImageViews[i] = gpu.createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+            swapChainImageViews[i] = gpu.createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
         }
     }
 
@@ -874,15 +1363,32 @@ private:
         fragment_uniform_binding.descriptorCount = 1;
         fragment_uniform_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
+        // the texture table, an array of every texture and normal map whose
+        // size is given when a set is allocated
+        textureTableSize = std::min(maxTableTextures, gpu.maxSampledImages);
         VkDescriptorSetLayoutBinding samplerLayoutBinding{};
         samplerLayoutBinding.binding = 0;
         samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        samplerLayoutBinding.descriptorCount = 1;
+        samplerLayoutBinding.descriptorCount = textureTableSize;
         samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
+        VkDescriptorBindingFlagsEXT tableFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT tableFlagsInfo{};
+        tableFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        tableFlagsInfo.bindingCount = 1;
+        tableFlagsInfo.pBindingFlags = &tableFlags;
+
+        // the draw data of every draw
+        VkDescriptorSetLayoutBinding draw_data_binding{};
+        draw_data_binding.binding = 0;
+        draw_data_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        draw_data_binding.descriptorCount = 1;
+        draw_data_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
         std::array<VkDescriptorSetLayoutBinding, 2> bindings_0 = {vertex_uniform_binding, fragment_uniform_binding};
         std::array<VkDescriptorSetLayoutBinding, 1> bindings_1 = {samplerLayoutBinding};
-        std::array<VkDescriptorSetLayoutBinding, 1> bindings_2 = {vertex_uniform_binding};
+        std::array<VkDescriptorSetLayoutBinding, 1> bindings_2 = {draw_data_binding};
 
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -896,11 +1402,13 @@ private:
 
         layoutInfo.bindingCount = 1;
 
+        layoutInfo.pNext = &tableFlagsInfo;
         layoutInfo.pBindings = bindings_1.data();
         if (vkCreateDescriptorSetLayout(gpu.logical_gpu, &layoutInfo, nullptr, &descriptorSetLayout_1) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor set layout!");
         }
 
+        layoutInfo.pNext = nullptr;
         layoutInfo.pBindings = bindings_2.data();
         if (vkCreateDescriptorSetLayout(gpu.logical_gpu, &layoutInfo, nullptr, &descriptorSetLayout_2) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor set layout!");
@@ -934,15 +1442,16 @@ private:
 
     void createDepthResources() {
         VkFormat depthFormat = findDepthFormat();
-        gpu.createImage(swapChainExtent.width, swapChainExtent.height, msaa->getSampleCount(),
-            depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthImage);
+        gpu.createImage(swapChainExtent.width, swapChainExtent.height, 1, msaa->getSampleCount(),
+            depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (cullOnGpu ? VK_IMAGE_USAGE_SAMPLED_BIT : 0),
+            depthImage);
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(gpu.logical_gpu, depthImage, &memRequirements);
         gpu.allocateMemory(memRequirements.size,
             gpu.findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
             depthImageMemory);
         vkBindImageMemory(gpu.logical_gpu, depthImage, depthImageMemory, 0);
-        depthImageView = gpu.createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+        depthImageView = gpu.createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
     }
 
     VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
@@ -962,7 +1471,7 @@ private:
         return findSupportedFormat(
             { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
             VK_IMAGE_TILING_OPTIMAL,
-            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | (cullOnGpu ? VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT : 0)
         );
     }
 
@@ -975,20 +1484,22 @@ private:
         create the discriptor pool
         */
 
-        // two types of discriptor
-        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        // three types of discriptor
+        std::array<VkDescriptorPoolSize, 3> poolSizes{};
         
         // the first type is uniform buffer
-        // (model matrix, view matrix, projection matrix, eye location, and light)
+        // (view matrix, projection matrix, eye location, and light)
         poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT *
-            (scene->meshes.size() + scene->meshes_with_normal_map.size() + 2));
+        poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT * 2;
 
-        // the second type image samplers for texture mapping
-        // TODO: maybe we only need as many descriptors and descriptor set as the number of textures.
+        // the second type image samplers, a texture table per frame and one
+        // for the font of imgui
         poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(
-            MAX_FRAMES_IN_FLIGHT * (scene->textures.size() + scene->normal_maps.size()) + 1);
+        poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT * textureTableSize + 1;
+
+        // the third type storage buffer for the draw data
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[2].descriptorCount = MAX_FRAMES_IN_FLIGHT;
 
         // prepare for pool creation
         VkDescriptorPoolCreateInfo poolInfo{};
@@ -996,9 +1507,7 @@ private:
         poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT *
-            (scene->meshes.size() + scene->meshes_with_normal_map.size() +
-            1 + scene->textures.size() + scene->normal_maps.size()) + 1);
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT * 3 + 1;
 
         // create the pool
         if (vkCreateDescriptorPool(gpu.logical_gpu, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
@@ -1015,19 +1524,11 @@ private:
             // this set is for view matrix, projection matrix, eye location, and lights
             layouts.push_back(descriptorSetLayout_0);
 
-            // these sets are for textures
-            for (int j = 0; j < scene->textures.size(); j++)
-                layouts.push_back(descriptorSetLayout_1);
-
-            // these sets are for normal maps
-            for (int j = 0; j < scene->normal_maps.size(); j++)
-                layouts.push_back(descriptorSetLayout_1);
+            // this set is the texture table, the textures then the normal maps
+            layouts.push_back(descriptorSetLayout_1);
 
-            // these sets are for model matrices
-            for (int j = 0; j < scene->meshes.size(); j++)
-                layouts.push_back(descriptorSetLayout_2);
-            for (int j = 0; j < scene->meshes_with_normal_map.size(); j++)
-                layouts.push_back(descriptorSetLayout_2);
+            // this set is for the draw data
+            layouts.push_back(descriptorSetLayout_2);
         }
 
         return layouts;
@@ -1036,10 +1537,24 @@ private:
     void allocate_descriptor_sets() {
         // arrange the layouts
         std::vector<VkDescriptorSetLayout> layouts = arrange_layouts();
+
+        // the texture tables hold every image of the scene, the other sets
+        // ignore their count
+        uint32_t numImages = static_cast<uint32_t>(scene->textures.size() + scene->normal_maps.size());
+        if (numImages > textureTableSize) {
+            throw std::runtime_error("failed to fit " + std::to_string(numImages) + " textures and normal maps in a texture table of " +
+                std::to_string(textureTableSize));
+        }
+        std::vector<uint32_t> variableCounts(layouts.size(), numImages);
+        VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountInfo{};
+        variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+        variableCountInfo.descriptorSetCount = static_cast<uint32_t>(variableCounts.size());
+        variableCountInfo.pDescriptorCounts = variableCounts.data();
         
         // prepare for allocation
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.pNext = &variableCountInfo;
         allocInfo.descriptorPool = descriptorPool;
         allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
         allocInfo.pSetLayouts = layouts.data();
@@ -1055,9 +1570,7 @@ private:
         
         VkDescriptorBufferInfo buffer_info{};
         buffer_info.buffer = scene->uniform_buffer->buffer;
-        std::vector<VkDescriptorBufferInfo> bufferInfos(
-            (2 + scene->meshes.size() + scene->meshes_with_normal_map.size()) *
-            MAX_FRAMES_IN_FLIGHT, buffer_info);
+        std::vector<VkDescriptorBufferInfo> bufferInfos(3 * MAX_FRAMES_IN_FLIGHT, buffer_info);
 
         VkDeviceSize offset = 0;
         int index = 0;
@@ -1075,13 +1588,11 @@ private:
             offset += gpu.getAlignSize(sizeof(FragmentUniform));
             index++;
 
-            // meshes
-            for (int j = 0; j < scene->meshes.size() + scene->meshes_with_normal_map.size(); j++) {
-                bufferInfos[index].offset = offset;
-                bufferInfos[index].range = sizeof(glm::mat4);
-                offset += gpu.getAlignSize(sizeof(glm::mat4));
-                index++;
-            }
+            // draw data, the same for every frame
+            bufferInfos[index].buffer = drawDataBuffer->buffer;
+            bufferInfos[index].offset = 0;
+            bufferInfos[index].range = VK_WHOLE_SIZE;
+            index++;
         }
 
         return bufferInfos;
@@ -1091,7 +1602,7 @@ private:
 
         VkDescriptorImageInfo image_info{};
         image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        image_info.sampler = textureSampler;
+        image_info.sampler = enableMipmaps ? textureSampler : baseLevelSampler;
         std::vector<VkDescriptorImageInfo> imageInfos(
             (scene->textures.size() + scene->normal_maps.size()) *
             MAX_FRAMES_IN_FLIGHT, image_info);
@@ -1121,8 +1632,8 @@ private:
     ) {
 
         std::vector<VkWriteDescriptorSet> descriptorWrites;
-        descriptorWrites.resize((2 + scene->textures.size() + scene->normal_maps.size() +
-            scene->meshes.size() + scene->meshes_with_normal_map.size()) * MAX_FRAMES_IN_FLIGHT);
+        descriptorWrites.resize(4 * MAX_FRAMES_IN_FLIGHT);
+        uint32_t numImages = static_cast<uint32_t>(scene->textures.size() + scene->normal_maps.size());
 
         int write_index = 0, set_index = 0, buffer_index = 0, image_index = 0;
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -1137,20 +1648,21 @@ private:
                 VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &bufferInfos[buffer_index], nullptr);
             write_index++; buffer_index++; set_index++;
             
-            // textures and normal maps
-            for (int j = 0; j < scene->textures.size() + scene->normal_maps.size(); j++) {
+            // textures and normal maps, the whole table in one write
+            if (numImages > 0) {
                 updateDescriptorWrite(descriptorWrites[write_index], descriptorSets[set_index], 0,
                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, &imageInfos[image_index]);
-                write_index++; image_index++; set_index++;
+                descriptorWrites[write_index].descriptorCount = numImages;
+                write_index++; image_index += numImages;
             }
+            set_index++;
 
-            // meshes
-            for (int j = 0; j < scene->meshes.size() + scene->meshes_with_normal_map.size(); j++) {
-                updateDescriptorWrite(descriptorWrites[write_index], descriptorSets[set_index], 0,
-                    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &bufferInfos[buffer_index], nullptr);
-                write_index++; buffer_index++; set_index++;
-            }
+            // draw data
+            updateDescriptorWrite(descriptorWrites[write_index], descriptorSets[set_index], 0,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &bufferInfos[buffer_index], nullptr);
+            write_index++; buffer_index++; set_index++;
         }
+        descriptorWrites.resize(write_index);
 
         return descriptorWrites;
     }
@@ -1162,6 +1674,14 @@ private:
 
         allocate_descriptor_sets();
 
+        writeDescriptorSets();
+    }
+
+    void writeDescriptorSets() {
+        /*
+        point the descriptor sets at the buffers and the images
+        */
+
         std::vector<VkDescriptorBufferInfo> bufferInfos = prepare_buffer_info();
 
         std::vector<VkDescriptorImageInfo> imageInfos = prepare_image_info();
@@ -1190,19 +1710,20 @@ private:
         descriptorWrite.pImageInfo = imageInfo;
     }
 
-    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-        VkCommandBuffer commandBuffer = gpu.beginSingleTimeCommands();
-
+    void transitionImageLayouts(VkCommandBuffer commandBuffer, const std::vector<VkImage>& images,
+        const std::vector<uint32_t>& mipLevels, VkImageLayout oldLayout, VkImageLayout newLayout) {
+        /*
+        Move all the mip levels of the images to a new layout with a single
+        pipeline barrier
+        */
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         barrier.oldLayout = oldLayout;
         barrier.newLayout = newLayout;
         barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = image;
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
         barrier.subresourceRange.baseArrayLayer = 0;
         barrier.subresourceRange.layerCount = 1;
 
@@ -1227,48 +1748,44 @@ private:
             throw std::invalid_argument("unsupported layout transition!");
         }
 
+        std::vector<VkImageMemoryBarrier> barriers(images.size(), barrier);
+        for (int i = 0; i < images.size(); i++) {
+            barriers[i].image = images[i];
+            barriers[i].subresourceRange.levelCount = mipLevels[i];
+        }
+
         vkCmdPipelineBarrier(
             commandBuffer,
             sourceStage, destinationStage,
             0,
             0, nullptr,
             0, nullptr,
-            1, &barrier
+            static_cast<uint32_t>(barriers.size()), barriers.data()
         );
-
-        gpu.endSingleTimeCommands(commandBuffer);
     }
 
-    void copyBufferToImage(VkBuffer buffer, VkDeviceSize buffer_offset, VkImage image, uint32_t width, uint32_t height) {
-        VkCommandBuffer commandBuffer = gpu.beginSingleTimeCommands();
-
+    VkBufferImageCopy imageCopyRegion(VkDeviceSize buffer_offset, uint32_t mipLevel, uint32_t y, uint32_t width, uint32_t height) {
+        /*
+        A copy of tightly packed rows from the buffer to a band of rows of a
+        mip level
+        */
         VkBufferImageCopy region{};
         region.bufferOffset = buffer_offset;
         region.bufferRowLength = 0;
         region.bufferImageHeight = 0;
 
         region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.mipLevel = mipLevel;
         region.imageSubresource.baseArrayLayer = 0;
         region.imageSubresource.layerCount = 1;
 
-        region.imageOffset = { 0, 0, 0 };
+        region.imageOffset = { 0, static_cast<int32_t>(y), 0 };
         region.imageExtent = {
             width,
             height,
             1
         };
-
-        vkCmdCopyBufferToImage(
-            commandBuffer,
-            buffer,
-            image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &region
-        );
-
-        gpu.endSingleTimeCommands(commandBuffer);
+        return region;
     }
 
     void createCommandBuffers() {
@@ -1294,10 +1811,10 @@ private:
         }
     }
 
-    void begin_render_pass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    void begin_render_pass(VkCommandBuffer commandBuffer, uint32_t imageIndex, RenderPass* pass) {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass->getRenderPass();
+        renderPassInfo.renderPass = pass->getRenderPass();
         renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
         renderPassInfo.renderArea.offset = { 0, 0 };
         renderPassInfo.renderArea.extent = swapChainExtent;
@@ -1336,139 +1853,151 @@ private:
         vkCmdBindIndexBuffer(commandBuffer, scene->index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
     }
 
-    void bind_global_uniform(VkCommandBuffer commandBuffer) {
+    int frameSetIndex() {
         /*
-        This includes view matrix, projection matrix, lights, eye position
+        Where the descriptor sets of the current frame start: the global
+        uniforms, the texture table, then the draw data
         */
-
-        int index = (1 + scene->textures.size() + scene->normal_maps.size() + scene->meshes.size() +
-            scene->meshes_with_normal_map.size()) * currentFrame;
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-            basic_graphic_pipeline.layout, 0, 1, &descriptorSets[index], 0, nullptr);
+        return 3 * currentFrame;
     }
 
-    void bind_texture(VkCommandBuffer commandBuffer, int i) {
+    void bind_global_uniform(VkCommandBuffer commandBuffer) {
         /*
-        Bind the ith texture
+        This includes view matrix, projection matrix, lights, eye position,
+        the texture table and the draw data. The pipelines share their
+        layouts, so these stay bound for all of them.
         */
-        int index = (1 + scene->textures.size() + scene->normal_maps.size() + scene->meshes.size() +
-            scene->meshes_with_normal_map.size()) * currentFrame + 1 + i;
         vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-            basic_graphic_pipeline.layout, 1, 1, &descriptorSets[index], 0, nullptr);
+            basic_graphic_pipeline.layout, 0, 3, &descriptorSets[frameSetIndex()], 0, nullptr);
     }
 
-    void render_basic_mesh(VkCommandBuffer commandBuffer, int i) {
-        /*
-        Render any basic mesh that has the ith texture
-        */
-        
-        // bind the pipeline to render basic meshes first
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, basic_graphic_pipeline.pipeline);
-
-        // for each mesh
-        for (int j = 0; j < scene->meshes.size(); j++) {
-
-            // if the mesh use the ith texture
-            if (scene->meshes[j].texture_index == i) {
-
-                // bind the model matrix
-                int index = (1 + scene->textures.size() + scene->normal_maps.size() + scene->meshes.size() +
-                    scene->meshes_with_normal_map.size()) * currentFrame + 1 + scene->textures.size() +
-                    scene->normal_maps.size() + j;
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    basic_graphic_pipeline.layout, 2, 1, &descriptorSets[index], 0, nullptr);
-
-                // draw call
-                vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(scene->meshes[j].indices.size()),
-                    1, scene->meshes[j].index_offset, scene->meshes[j].vertex_offset, 0);
-            }
+    Pipeline& drawPipeline(DrawPipeline pipeline) {
+        switch (pipeline) {
+        case DRAW_PIPELINE_BASIC_T: return basic_t_graphic_pipeline;
+        case DRAW_PIPELINE_NORMAL_MAPPING: return normal_mapping_pipeline;
+        default: return basic_graphic_pipeline;
         }
     }
 
-    void render_normal_map_meshes_without_normal_map(VkCommandBuffer commandBuffer, int i) {
-        // bind the pipeline that render the meshes_with_normal_map
-        // without normal mapping
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, basic_t_graphic_pipeline.pipeline);
-
-        // for each mesh
-        for (int j = 0; j < scene->meshes_with_normal_map.size(); j++) {
+    void render_all_meshes(VkCommandBuffer commandBuffer) {
+        bind_vertex_and_index_buffer(commandBuffer);
 
-            // if the mesh use the ith texture
-            if (scene->meshes_with_normal_map[j].texture_index == i) {
+        bind_global_uniform(commandBuffer);
+        drawStats.descriptor_binds++;
+
+        // if normal mapping is disabled, meshes with normal map are drawn
+        // the same way as meshes
+        DrawPipeline withNormalMap = scene->enable_normal_map ? DRAW_PIPELINE_NORMAL_MAPPING : DRAW_PIPELINE_BASIC_T;
+        if (indirectDraws && gpu.multiDrawIndirect && cpuFrustumCulling) {
+            uint32_t first = drawList.first_with_normal_map;
+            render_indirect(commandBuffer, DRAW_PIPELINE_BASIC, 0, 0, visibleCounts[0],
+                visibleCommandBuffers[currentFrame], nullptr);
+            render_indirect(commandBuffer, withNormalMap, 1, first, first + visibleCounts[1],
+                visibleCommandBuffers[currentFrame], nullptr);
+        } else if (indirectDraws && gpu.multiDrawIndirect) {
+            render_indirect(commandBuffer, DRAW_PIPELINE_BASIC, 0, 0, drawList.first_with_normal_map,
+                indirectBuffer, drawCountBuffer);
+            render_indirect(commandBuffer, withNormalMap, 1, drawList.first_with_normal_map, drawList.draws.size(),
+                indirectBuffer, drawCountBuffer);
+        } else render_sorted(commandBuffer);
+    }
+
+    void render_culled_meshes(VkCommandBuffer commandBuffer) {
+        /*
+        Draw the commands the culling compacted in the last phase, each range
+        holds at most its draws and the GPU counted how many it has
+        */
+        bind_vertex_and_index_buffer(commandBuffer);
 
-                // bind the model matrix
-                int index = (1 + scene->textures.size() + scene->normal_maps.size() + scene->meshes.size() +
-                    scene->meshes_with_normal_map.size()) * currentFrame + 1 + scene->textures.size() +
-                    scene->normal_maps.size() + scene->meshes.size() + j;
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    basic_t_graphic_pipeline.layout, 2, 1, &descriptorSets[index],0, nullptr);
+        bind_global_uniform(commandBuffer);
+        drawStats.descriptor_binds++;
 
-                // draw call
-                vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(scene->meshes_with_normal_map[j].indices.size()),
-                    1, scene->meshes_with_normal_map[j].index_offset, scene->meshes_with_normal_map[j].vertex_offset, 0);
-            }
-        }
+        DrawPipeline withNormalMap = scene->enable_normal_map ? DRAW_PIPELINE_NORMAL_MAPPING : DRAW_PIPELINE_BASIC_T;
+        render_indirect(commandBuffer, DRAW_PIPELINE_BASIC, 0, 0, drawList.first_with_normal_map,
+            culling->commands, culling->counts);
+        render_indirect(commandBuffer, withNormalMap, 1, drawList.first_with_normal_map, drawList.draws.size(),
+            culling->commands, culling->counts);
     }
 
-    void render_normal_map_meshes(VkCommandBuffer commandBuffer, int i) {
-        // bind normal mapping pipeline
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, normal_mapping_pipeline.pipeline);
-
-        // for each mesh
-        for (int j = 0; j < scene->meshes_with_normal_map.size(); j++) {
-
-            // if the mesh use the ith texture
-            if (scene->meshes_with_normal_map[j].texture_index == i) {
-
-                // bind the normal map and the model matrix
-                int index_0 = (1 + scene->textures.size() + scene->normal_maps.size() + scene->meshes.size() +
-                    scene->meshes_with_normal_map.size())* currentFrame + 1 + scene->textures.size() +
-                    scene->meshes_with_normal_map[j].normal_map_index;
-                int index_1 = (1 + scene->textures.size() + scene->normal_maps.size() + scene->meshes.size() +
-                    scene->meshes_with_normal_map.size()) * currentFrame + 1 + scene->textures.size() +
-                    scene->normal_maps.size() + scene->meshes.size() + j;
-                std::vector<VkDescriptorSet> descriptor_sets = { descriptorSets[index_0], descriptorSets[index_1] };
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    normal_mapping_pipeline.layout, 2, 2, descriptor_sets.data(), 0, nullptr);
+    void render_indirect(VkCommandBuffer commandBuffer, DrawPipeline pipeline, int range, uint32_t first, uint32_t end,
+        Buffer* commands, Buffer* counts) {
+        /*
+        Draw a range of the indirect commands with a pipeline, in as few calls
+        as the device allows. The count variant reads how many draws there are
+        from the count of the range in the count buffer, without a count
+        buffer the range is drawn whole.
+        */
+        if (first == end) return;
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline(pipeline).pipeline);
+        drawStats.pipeline_binds++;
+        drawStats.draws += end - first;
 
-                // draw call
-                vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(scene->meshes_with_normal_map[j].indices.size()),
-                    1, scene->meshes_with_normal_map[j].index_offset, scene->meshes_with_normal_map[j].vertex_offset, 0);
-            }
+        uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        if (counts != nullptr && gpu.cmdDrawIndexedIndirectCount != nullptr && end - first <= gpu.maxDrawIndirectCount) {
+            gpu.cmdDrawIndexedIndirectCount(commandBuffer, commands->buffer, first * stride,
+                counts->buffer, range * sizeof(uint32_t), end - first, stride);
+            drawStats.draw_calls++;
+            return;
+        }
+        for (uint32_t start = first; start < end; start += gpu.maxDrawIndirectCount) {
+            uint32_t count = std::min(end - start, gpu.maxDrawIndirectCount);
+            vkCmdDrawIndexedIndirect(commandBuffer, commands->buffer, start * stride, count, stride);
+            drawStats.draw_calls++;
         }
     }
 
-    void render_all_meshes(VkCommandBuffer commandBuffer) {
-        bind_vertex_and_index_buffer(commandBuffer);
-
-        bind_global_uniform(commandBuffer);
-
-        // for each texture
-        for (int i = 0; i < scene->textures.size(); i++) {
-
-            bind_texture(commandBuffer, i);
-
-            render_basic_mesh(commandBuffer, i);
-
-            // if normal mapping is disabled, draw meshes with normal map
-            // the same way as meshes
-            if (!scene->enable_normal_map)
-                render_normal_map_meshes_without_normal_map(commandBuffer, i);
-            else render_normal_map_meshes(commandBuffer, i);
+    void render_sorted(VkCommandBuffer commandBuffer) {
+        /*
+        Record a draw call for every draw sorted by pipeline, texture and
+        depth, a pipeline is bound when it changes. The first instance of a
+        draw is its draw data.
+        */
+        drawList.sort(scene->camera.cameraPos, scene->camera.cameraFront, scene->enable_normal_map);
+
+        int boundPipeline = -1;
+        for (uint32_t d : drawList.order) {
+            if (cpuFrustumCulling && !drawVisible[d]) continue;
+            const Draw& draw = drawList.draws[d];
+            if (draw.pipeline != boundPipeline) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline(draw.pipeline).pipeline);
+                boundPipeline = draw.pipeline;
+                drawStats.pipeline_binds++;
+            }
+            vkCmdDrawIndexed(commandBuffer, draw.index_count, 1, draw.index_offset, draw.vertex_offset, d);
+            drawStats.draws++;
+            drawStats.draw_calls++;
         }
     }
 
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
         
         begin_command_buffer(commandBuffer);
-
-        begin_render_pass(commandBuffer, imageIndex);
+        drawStats = {};
+
+        // with culling on the GPU, the draws visible in the last frame are
+        // drawn first and the depth pyramid is built from their depth, then
+        // the draws that came into view are drawn over them
+        if (culling != nullptr) {
+            glm::mat4 view = viewMatrix();
+            glm::mat4 projection = projectionMatrix();
+            culling->cullEarly(commandBuffer, view, projection);
+            begin_render_pass(commandBuffer, imageIndex, earlyRenderPass);
+            set_viewport(commandBuffer);
+            set_scissor(commandBuffer);
+            render_culled_meshes(commandBuffer);
+            vkCmdEndRenderPass(commandBuffer);
+
+            culling->buildPyramid(commandBuffer);
+            culling->cullLate(commandBuffer, view, projection, currentFrame);
+            begin_render_pass(commandBuffer, imageIndex, lateRenderPass);
+        } else begin_render_pass(commandBuffer, imageIndex, renderPass);
 
         set_viewport(commandBuffer);
 
         set_scissor(commandBuffer);
 
-        render_all_meshes(commandBuffer);
+        if (culling != nullptr) render_culled_meshes(commandBuffer);
+        else render_all_meshes(commandBuffer);
 
         // Record dear imgui primitives into command buffer
         ImGui_ImplVulkan_RenderDrawData(imgui_draw_data, commandBuffer);
@@ -1522,19 +2051,28 @@ private:
         return imageIndex;
     }
 
-    void update_view_projection(char* p, size_t& offset) {
-        ViewProjectrion view_proj_matrix;
-        view_proj_matrix.view = lookAt(
+    glm::mat4 viewMatrix() {
+        return lookAt(
             scene->camera.cameraPos,
             scene->camera.cameraPos + scene->camera.cameraFront,
             scene->camera.cameraUp
         );
-        view_proj_matrix.proj = perspective(
-            glm::radians(45.0f),
+    }
+
+    glm::mat4 projectionMatrix() {
+        glm::mat4 proj = perspective(
+            glm::radians(fieldOfView),
             swapChainExtent.width / (float)swapChainExtent.height,
-            0.1f, 100.0f
+            nearPlane, farPlane
         );
-        view_proj_matrix.proj[1][1] *= -1;
+        proj[1][1] *= -1;
+        return proj;
+    }
+
+    void update_view_projection(char* p, size_t& offset) {
+        ViewProjectrion view_proj_matrix;
+        view_proj_matrix.view = viewMatrix();
+        view_proj_matrix.proj = projectionMatrix();
         memcpy(p + offset, &view_proj_matrix, sizeof(ViewProjectrion));
         offset += gpu.getAlignSize(sizeof(ViewProjectrion));
     }
@@ -1545,18 +2083,6 @@ private:
         offset += gpu.getAlignSize(sizeof(FragmentUniform));
     }
 
-    void update_model_tranforms(char* p, size_t& offset) {
-        for (int i = 0; i < scene->meshes.size(); i++) {
-            memcpy(p + offset, &scene->meshes[i].init_transform, sizeof(glm::mat4));
-            offset += gpu.getAlignSize(sizeof(glm::mat4));
-        }
-        for (int i = 0; i < scene->meshes_with_normal_map.size(); i++) {
-            memcpy(p + offset,
-                &scene->meshes_with_normal_map[i].init_transform, sizeof(glm::mat4));
-            offset += gpu.getAlignSize(sizeof(glm::mat4));
-        }
-    }
-
     void update_uniform_buffer() {
         /*
         Update the uniform buffer
@@ -1566,9 +2092,7 @@ private:
         char* p = (char*)scene->uniformBuffersMapped;
         size_t offset = currentFrame * (
             gpu.getAlignSize(sizeof(ViewProjectrion)) +
-            gpu.getAlignSize(sizeof(FragmentUniform)) +
-            gpu.getAlignSize(sizeof(glm::mat4)) *
-            (scene->meshes.size() + scene->meshes_with_normal_map.size())
+            gpu.getAlignSize(sizeof(FragmentUniform))
         );
 
         // update the view and projection matrix
@@ -1576,9 +2100,211 @@ private:
 
         // update the eye location
         update_eye(p, offset);
+    }
 
-        // update model transforms
-        update_model_tranforms(p, offset);
+    void createDrawBuffers() {
+        /*
+        Upload the draw data and the indirect commands of the draws, the
+        meshes don't move so they are written once
+        */
+        std::vector<DrawData> drawData = drawList.draw_data();
+        drawDataBuffer = new Buffer(&gpu, std::max<size_t>(drawData.size(), 1) * sizeof(DrawData),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        stagingRing->uploadBuffer(drawData.data(), drawData.size() * sizeof(DrawData), drawDataBuffer->buffer, 0);
+
+        std::vector<VkDrawIndexedIndirectCommand> commands = drawList.indirect_commands();
+        indirectBuffer = new Buffer(&gpu, std::max<size_t>(commands.size(), 1) * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        stagingRing->uploadBuffer(commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand),
+            indirectBuffer->buffer, 0);
+
+        // the meshes, then the meshes with normal map
+        uint32_t counts[2] = { drawList.first_with_normal_map,
+            static_cast<uint32_t>(drawList.draws.size()) - drawList.first_with_normal_map };
+        drawCountBuffer = new Buffer(&gpu, sizeof(counts),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        stagingRing->uploadBuffer(counts, sizeof(counts), drawCountBuffer->buffer, 0);
+
+        // the visible commands are written by the CPU every frame
+        drawCommands = commands;
+        frustumCuller.setBounds(drawList.bounds());
+        for (int i = 0; cpuFrustumCulling && i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkDeviceSize size = std::max<size_t>(commands.size(), 1) * sizeof(VkDrawIndexedIndirectCommand);
+            Buffer* buffer = new Buffer(&gpu, size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            void* data;
+            vkMapMemory(gpu.logical_gpu, buffer->memory, 0, size, 0, &data);
+            visibleCommandBuffers.push_back(buffer);
+            visibleCommands.push_back(static_cast<VkDrawIndexedIndirectCommand*>(data));
+        }
+    }
+
+    void cullDraws() {
+        /*
+        Test the bounds of every draw against the frustum before recording,
+        and write the commands of the visible draws to the commands of the
+        frame, whose fence was waited for
+        */
+        Timer timer;
+        glm::mat4 viewProjection = projectionMatrix() * viewMatrix();
+        if (bvhFrustumCulling) {
+            cullNodesVisited = cull_scene(*scene, viewProjection, meshVisible);
+            drawVisible.resize(drawList.draws.size());
+            for (uint32_t i = 0; i < drawVisible.size(); i++) drawVisible[i] = meshVisible[drawList.draws[i].mesh];
+        } else {
+            frustumCuller.cull(viewProjection, drawVisible);
+        }
+        visibleCounts[0] = 0;
+        visibleCounts[1] = 0;
+        drawsCulled = 0;
+        VkDrawIndexedIndirectCommand* commands = visibleCommands[currentFrame];
+        for (uint32_t i = 0; i < drawVisible.size(); i++) {
+            if (!drawVisible[i]) {
+                drawsCulled++;
+                continue;
+            }
+            int range = i < drawList.first_with_normal_map ? 0 : 1;
+            uint32_t first = range == 0 ? 0 : drawList.first_with_normal_map;
+            commands[first + visibleCounts[range]++] = drawCommands[i];
+        }
+        frustumCullTime = timer.total();
+    }
+
+    void computeMeshFootprints() {
+        /*
+        The bounding spheres and uv densities the residency requests levels
+        with and the draws are sorted by, the meshes don't move
+        */
+        meshFootprints.resize(scene->meshes.size());
+        parallel_for(scene->meshes.size(), [&](int i) {
+            const Mesh& mesh = scene->meshes[i];
+            meshFootprints[i] = mesh_footprint(scene->vertices.data() + mesh.vertex_offset, mesh.vertex_count,
+                scene->indices.data() + mesh.index_offset, mesh.index_count, mesh.init_transform);
+        });
+        meshWithNormalMapFootprints.resize(scene->meshes_with_normal_map.size());
+        parallel_for(scene->meshes_with_normal_map.size(), [&](int i) {
+            const MeshWithNormalMap& mesh = scene->meshes_with_normal_map[i];
+            meshWithNormalMapFootprints[i] = mesh_footprint(scene->vertices_with_tangent.data() + mesh.vertex_offset,
+                mesh.vertex_count, scene->indices.data() + mesh.index_offset, mesh.index_count, mesh.init_transform);
+        });
+    }
+
+    void requestLevel(int image, const MeshFootprint& footprint, const glm::vec4 planes[6], float pixelSize) {
+        /*
+        Ask for the level of an image that a visible mesh needs: a pixel at the
+        nearest point of the mesh covers uv_density * distance * pixelSize uv
+        units, which are that many times the size of the image in texels
+        */
+        if (image < 0 || !sphere_in_frustum(planes, footprint.center, footprint.radius)) return;
+        float distance = std::max(glm::length(footprint.center - scene->camera.cameraPos) - footprint.radius, nearPlane);
+        const ImageSlot& slot = streamedImages[image].slot;
+        residency->request(image, footprint.uv_density * std::max(slot.width, slot.height) * distance * pixelSize);
+    }
+
+    void requestVisibleLevels() {
+        glm::vec4 planes[6];
+        frustum_planes(projectionMatrix() * viewMatrix(), planes);
+
+        // the size of a pixel at a distance of 1
+        float pixelSize = 2.0f * tan(glm::radians(fieldOfView) / 2.0f) / swapChainExtent.height;
+
+        residency->begin_frame();
+        for (int i = 0; i < scene->meshes.size(); i++) {
+            requestLevel(scene->meshes[i].texture_index, meshFootprints[i], planes, pixelSize);
+        }
+        int numTextures = scene->textures.size();
+        for (int i = 0; i < scene->meshes_with_normal_map.size(); i++) {
+            const MeshWithNormalMap& mesh = scene->meshes_with_normal_map[i];
+            requestLevel(mesh.texture_index, meshWithNormalMapFootprints[i], planes, pixelSize);
+
+            // the normal maps are only sampled with normal mapping on
+            if (scene->enable_normal_map && mesh.normal_map_index >= 0) {
+                requestLevel(numTextures + mesh.normal_map_index, meshWithNormalMapFootprints[i], planes, pixelSize);
+            }
+        }
+    }
+
+    void streamTextureLevels() {
+        /*
+        Ask for the levels the visible meshes need and make the changes the
+        residency decides on: every changed image is created again with its
+        new levels and uploaded through the staging ring ahead of this frame.
+        The descriptor sets of this frame point at the new images right away,
+        the sets of the frames in flight when their turn comes.
+        */
+        frameNumber++;
+        destroyRetiredImages(frameNumber);
+        requestVisibleLevels();
+
+        std::vector<ResidencyChange> changes = residency->update();
+        int numTextures = scene->textures.size();
+        for (const ResidencyChange& change : changes) {
+            StreamedImage& streamed = streamedImages[change.image];
+            retiredImages.push_back({ streamed.image, streamed.memory, streamed.view, frameNumber });
+            std::vector<ImageSlot> levelSlots = { image_slot_levels(streamed.slot, change.level) };
+            residency->set_resident(change.image, change.level, createResidentImage(streamed, levelSlots[0]));
+            uploadImages(levelSlots, streamed.numChannels, streamed.srgb, { streamed.image }, false);
+            streamed.staleFrames = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+
+            // keep the images the descriptor sets are written from current
+            if (change.image < numTextures) {
+                textureImage[change.image] = streamed.image;
+                textureImageView[change.image] = streamed.view;
+                textureMipLevels[change.image] = levelSlots[0].mip_levels;
+            } else {
+                normalMapImage[change.image - numTextures] = streamed.image;
+                normalMapImageView[change.image - numTextures] = streamed.view;
+                normalMapMipLevels[change.image - numTextures] = levelSlots[0].mip_levels;
+            }
+        }
+
+        // the copies are submitted before the frame that samples them
+        if (!changes.empty()) stagingRing->submit();
+        writeStaleDescriptorSets();
+    }
+
+    void writeStaleDescriptorSets() {
+        /*
+        Point the texture table of this frame at the images that changed, the
+        previous use of the table by this frame is done
+        */
+        std::vector<VkDescriptorImageInfo> imageInfos;
+        std::vector<int> tableIndices;
+        for (StreamedImage& streamed : streamedImages) {
+            if (!(streamed.staleFrames & (1u << currentFrame))) continue;
+            streamed.staleFrames &= ~(1u << currentFrame);
+            VkDescriptorImageInfo imageInfo{};
+            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageInfo.imageView = streamed.view;
+            imageInfo.sampler = enableMipmaps ? textureSampler : baseLevelSampler;
+            imageInfos.push_back(imageInfo);
+            tableIndices.push_back(streamed.tableIndex);
+        }
+        if (imageInfos.empty()) return;
+
+        std::vector<VkWriteDescriptorSet> descriptorWrites(imageInfos.size());
+        for (int i = 0; i < imageInfos.size(); i++) {
+            updateDescriptorWrite(descriptorWrites[i], descriptorSets[frameSetIndex() + 1], 0,
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, &imageInfos[i]);
+            descriptorWrites[i].dstArrayElement = tableIndices[i];
+        }
+        vkUpdateDescriptorSets(gpu.logical_gpu, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    void destroyRetiredImages(uint64_t frame) {
+        /*
+        Destroy the images replaced at least MAX_FRAMES_IN_FLIGHT frames
+        before frame, the frames that could still sample them are done
+        */
+        auto done = [&](const RetiredImage& retired) {
+            if (frame != UINT64_MAX && retired.frame + MAX_FRAMES_IN_FLIGHT > frame) return false;
+            vkDestroyImageView(gpu.logical_gpu, retired.view, nullptr);
+            vkDestroyImage(gpu.logical_gpu, retired.image, nullptr);
+            vkFreeMemory(gpu.logical_gpu, retired.memory, nullptr);
+            return true;
+        };
+        retiredImages.erase(std::remove_if(retiredImages.begin(), retiredImages.end(), done), retiredImages.end());
     }
 
     void submit_draw_command_buffer() {
@@ -1633,6 +2359,12 @@ private:
         uint32_t imageIndex = get_next_image();
         if (imageIndex == -1) return;
 
+        // the fence of the frame is signaled, so its stats were copied back
+        if (culling != nullptr) culling->readStats(currentFrame);
+        else if (cpuFrustumCulling) cullDraws();
+
+        if (streamTextures) streamTextureLevels();
+
         update_uniform_buffer();
 
         vkResetCommandBuffer(commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
@@ -1692,6 +2424,10 @@ private:
 
         std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
+        // the device features of descriptor indexing are queried through it on
+        // Vulkan 1.0
+        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
@@ -0,0 +1,88 @@
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+MappedFile::MappedFile(std::string path) {
+	/*
+	Map the file into memory so it can be parsed in place. The pages are
+	backed by the file, so they don't count against the heap and the OS can
+	drop them once they are parsed. An empty file has no mapping.
+	*/
+
+	data = nullptr;
+	size = 0;
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("failed to open " + path);
+	file_handle = file;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		throw std::runtime_error("failed to get the size of " + path);
+	}
+	size = file_size.QuadPart;
+	if (size == 0) return;
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		throw std::runtime_error("failed to map " + path);
+	}
+	mapping_handle = mapping;
+	data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("failed to map " + path);
+	}
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) throw std::runtime_error("failed to open " + path);
+	struct stat file_stat;
+	if (fstat(file, &file_stat) != 0) {
+		close(file);
+		throw std::runtime_error("failed to get the size of " + path);
+	}
+	size = file_stat.st_size;
+	if (size > 0) {
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapping == MAP_FAILED) {
+			close(file);
+			throw std::runtime_error("failed to map " + path);
+		}
+		madvise(mapping, size, MADV_SEQUENTIAL);
+		data = static_cast<const char*>(mapping);
+	}
+
+	// the mapping stays valid after the file is closed
+	close(file);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+	if (file_handle != nullptr) CloseHandle(file_handle);
+#else
+	if (data != nullptr) munmap(const_cast<char*>(data), size);
+#endif
+}
+
+std::string_view MappedFile::text() const {
+	return std::string_view(data, size);
+}
\ No newline at end of file
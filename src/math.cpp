@@ -45,4 +45,33 @@ glm::mat4 transpose(glm::mat4 matrix) {
 		glm::row(matrix, 2),
 		glm::row(matrix, 3)
 	);
+}
+
+void frustum_planes(glm::mat4 view_projection, glm::vec4 planes[6]) {
+	/*
+	Add and subtract the rows of the matrix, a point is inside when it is on
+	the positive side of every plane. The near plane is the one of a -1 to 1
+	depth range, which is also right for 0 to 1 but a bit loose.
+	*/
+	glm::vec4 x = glm::row(view_projection, 0);
+	glm::vec4 y = glm::row(view_projection, 1);
+	glm::vec4 z = glm::row(view_projection, 2);
+	glm::vec4 w = glm::row(view_projection, 3);
+	planes[0] = w + x;
+	planes[1] = w - x;
+	planes[2] = w + y;
+	planes[3] = w - y;
+	planes[4] = w + z;
+	planes[5] = w - z;
+	for (int i = 0; i < 6; i++) {
+		float length = sqrt(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+		planes[i] /= length;
+	}
+}
+
+bool sphere_in_frustum(const glm::vec4 planes[6], glm::vec3 center, float radius) {
+	for (int i = 0; i < 6; i++) {
+		if (dot(planes[i], glm::vec4(center, 1.0f)) < -radius) return false;
+	}
+	return true;
 }
\ No newline at end of file
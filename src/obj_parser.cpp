@@ -0,0 +1,183 @@
+#include <stdexcept>
+#include <string_view>
+
+#include "mapped_file.h"
+#include "obj_parser.h"
+#include "parallel.h"
+#include "string_utils.h"
+
+enum ObjEventType {
+	OBJ_OBJECT,
+	OBJ_MATERIAL
+};
+
+struct ObjEvent {
+	/*
+	An object or material record. These records decide how the faces are
+	grouped, so they remember how many faces of the chunk came before them.
+	The text points into the mapped file.
+	*/
+	ObjEventType type;
+	std::string_view text;
+	size_t num_faces;
+	size_t num_vertex_indices;
+};
+
+struct ObjChunk {
+	std::vector<glm::vec3> coordinates;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> uv;
+	std::vector<int> face_sizes;
+	std::vector<int> vertex_indices;
+	std::vector<ObjEvent> events;
+};
+
+float parse_next_float(std::string_view& s) {
+	float value;
+	if (!parse_float(next_token(s, ' '), value)) throw std::invalid_argument("failed to parse a number");
+	return value;
+}
+
+int parse_next_index(std::string_view& face_vertex) {
+	int value;
+	if (!parse_int(next_token(face_vertex, '/'), value)) throw std::invalid_argument("failed to parse a face index");
+	return value;
+}
+
+glm::vec3 parse_coordinates(std::string_view line, int start) {
+	line = line.substr(start);
+	float x = parse_next_float(line);
+	float y = parse_next_float(line);
+	float z = parse_next_float(line);
+	return glm::vec3(x, y, z);
+}
+
+glm::vec2 parse_uv(std::string_view line) {
+	line = line.substr(3);
+	float u = parse_next_float(line);
+	float v = parse_next_float(line);
+	return glm::vec2(u, v);
+}
+
+void parse_face(std::string_view line, ObjChunk& chunk) {
+	/*
+	Turn the "p/t/n p/t/n ..." text of a face into index triplets right away
+	so that the face text doesn't have to be kept around
+	*/
+	line = line.substr(2);
+	int num_vertices = 0;
+	while (!line.empty()) {
+		std::string_view face_vertex = next_token(line, ' ');
+		if (face_vertex.empty()) continue;
+		int pos_index = parse_next_index(face_vertex);
+		int uv_index = parse_next_index(face_vertex);
+		int nor_index = parse_next_index(face_vertex);
+		chunk.vertex_indices.push_back(pos_index);
+		chunk.vertex_indices.push_back(uv_index);
+		chunk.vertex_indices.push_back(nor_index);
+		num_vertices++;
+	}
+	chunk.face_sizes.push_back(num_vertices);
+}
+
+void parse_obj_chunk(std::string_view text, ObjChunk& chunk) {
+	/*
+	Parse the lines of a chunk. The chunk starts at the beginning of a line
+	and ends after a new line or at the end of the file.
+	*/
+
+	while (!text.empty()) {
+		std::string_view line = next_line(text);
+		char c0 = char_at(line, 0);
+		char c1 = char_at(line, 1);
+
+		if (c0 == 'v' && c1 == ' ') chunk.coordinates.push_back(parse_coordinates(line, 2));
+		if (c0 == 'v' && c1 == 'n') chunk.normals.push_back(parse_coordinates(line, 3));
+		if (c0 == 'v' && c1 == 't') chunk.uv.push_back(parse_uv(line));
+		if (c0 == 'o') chunk.events.push_back({ OBJ_OBJECT, line.substr(2), chunk.face_sizes.size(), chunk.vertex_indices.size() });
+		if (c0 == 'u') chunk.events.push_back({ OBJ_MATERIAL, line.substr(7), chunk.face_sizes.size(), chunk.vertex_indices.size() });
+		if (c0 == 'f') parse_face(line, chunk);
+	}
+}
+
+template <typename T>
+void append_range(std::vector<T>& destination, const std::vector<T>& source, size_t begin, size_t end) {
+	destination.insert(destination.end(), source.begin() + begin, source.begin() + end);
+}
+
+void parse_obj(std::string obj_path, ObjData& data) {
+	/*
+	Map the file, split it into chunks that start at the beginning of a line,
+	parse the chunks in parallel and merge them in file order. The result is
+	the same as reading the file line by line. Nothing is copied out of the
+	file except the parsed numbers and the group names.
+	*/
+
+	MappedFile file(obj_path);
+	std::string_view text = file.text();
+
+	// find the chunk boundaries, moving each one to the start of the next line
+	int num_chunks = get_num_workers() * 4;
+	std::vector<size_t> boundaries(num_chunks + 1);
+	boundaries[0] = 0;
+	for (int i = 1; i < num_chunks; i++) {
+		size_t boundary = text.size() / num_chunks * i;
+		if (boundary < boundaries[i - 1]) boundary = boundaries[i - 1];
+		size_t new_line = text.find('\n', boundary == 0 ? 0 : boundary - 1);
+		boundaries[i] = new_line == std::string_view::npos ? text.size() : new_line + 1;
+	}
+	boundaries[num_chunks] = text.size();
+
+	// parse the chunks
+	std::vector<ObjChunk> chunks(num_chunks);
+	parallel_for(num_chunks, [&](int i) {
+		parse_obj_chunk(text.substr(boundaries[i], boundaries[i + 1] - boundaries[i]), chunks[i]);
+	});
+
+	// merge the vertex attributes
+	size_t num_coordinates = 0, num_normals = 0, num_uv = 0;
+	for (int i = 0; i < num_chunks; i++) {
+		num_coordinates += chunks[i].coordinates.size();
+		num_normals += chunks[i].normals.size();
+		num_uv += chunks[i].uv.size();
+	}
+	data.coordinates.reserve(num_coordinates);
+	data.normals.reserve(num_normals);
+	data.uv.reserve(num_uv);
+	for (int i = 0; i < num_chunks; i++) {
+		data.coordinates.insert(data.coordinates.end(), chunks[i].coordinates.begin(), chunks[i].coordinates.end());
+		data.normals.insert(data.normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+		data.uv.insert(data.uv.end(), chunks[i].uv.begin(), chunks[i].uv.end());
+		std::vector<glm::vec3>().swap(chunks[i].coordinates);
+		std::vector<glm::vec3>().swap(chunks[i].normals);
+		std::vector<glm::vec2>().swap(chunks[i].uv);
+	}
+
+	// group the faces by object and material, releasing each chunk once it is merged
+	std::string_view object;
+	std::string_view material;
+	ObjGroup group;
+	for (int i = 0; i < num_chunks; i++) {
+		ObjChunk& chunk = chunks[i];
+		size_t face = 0;
+		size_t vertex_index = 0;
+		for (int j = 0; j < chunk.events.size(); j++) {
+			ObjEvent& event = chunk.events[j];
+			append_range(group.face_sizes, chunk.face_sizes, face, event.num_faces);
+			append_range(group.vertex_indices, chunk.vertex_indices, vertex_index, event.num_vertex_indices);
+			face = event.num_faces;
+			vertex_index = event.num_vertex_indices;
+			if (!group.face_sizes.empty()) {
+				group.material = std::string(material);
+				group.debug_node_name = std::string(object) + "_" + std::string(material);
+				data.groups.push_back(std::move(group));
+				group = ObjGroup();
+			}
+			if (event.type == OBJ_OBJECT) object = event.text;
+			else material = event.text;
+		}
+		append_range(group.face_sizes, chunk.face_sizes, face, chunk.face_sizes.size());
+		append_range(group.vertex_indices, chunk.vertex_indices, vertex_index, chunk.vertex_indices.size());
+		chunk = ObjChunk();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+#include "occlusion_culling.h"
+
+static uint32_t previous_power_of_two(uint32_t value) {
+	uint32_t result = 1;
+	while (result * 2 <= value) result *= 2;
+	return result;
+}
+
+static uint32_t group_count(uint32_t size, uint32_t group_size) {
+	return (size + group_size - 1) / group_size;
+}
+
+static VkImageView create_level_view(GPU* gpu, VkImage image, uint32_t level) {
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_R32_SFLOAT;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = level;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	VkImageView view;
+	if (vkCreateImageView(gpu->logical_gpu, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create depth pyramid level view!");
+	}
+	return view;
+}
+
+static VkDescriptorSetLayout create_set_layout(GPU* gpu, const std::vector<VkDescriptorType>& types) {
+	std::vector<VkDescriptorSetLayoutBinding> bindings(types.size());
+	for (uint32_t i = 0; i < types.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = types[i];
+		bindings[i].pImmutableSamplers = nullptr;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = bindings.size();
+	layoutInfo.pBindings = bindings.data();
+
+	VkDescriptorSetLayout layout;
+	if (vkCreateDescriptorSetLayout(gpu->logical_gpu, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor set layout!");
+	}
+	return layout;
+}
+
+static void compute_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+	VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dst_access;
+	vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+OcclusionCulling::OcclusionCulling(GPU* gpu_, const DrawList& draw_list, Buffer* indirect_buffer, StagingRing* staging_ring) {
+	/*
+	The buffers live as long as the scene, the pyramid is made for the depth
+	buffer separately
+	*/
+	gpu = gpu_;
+	occlusion = true;
+	stats = {};
+	draw_count = draw_list.draws.size();
+	first_with_normal_map = draw_list.first_with_normal_map;
+	pyramid = VK_NULL_HANDLE;
+	pyramid_memory = VK_NULL_HANDLE;
+	pyramid_view = VK_NULL_HANDLE;
+	pyramid_width = 0;
+	pyramid_height = 0;
+	depth_samples = VK_SAMPLE_COUNT_1_BIT;
+
+	size_t slots = std::max<size_t>(draw_count, 1);
+	commands = new Buffer(gpu, slots * sizeof(VkDrawIndexedIndirectCommand),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	counts = new Buffer(gpu, 2 * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	stats_buffer = new Buffer(gpu, sizeof(CullStats),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// the meshes don't move, so the spheres are written once, and nothing was
+	// visible before the first frame
+	std::vector<glm::vec4> spheres(draw_count);
+	for (uint32_t i = 0; i < draw_count; i++) {
+		spheres[i] = glm::vec4(draw_list.draws[i].bounds.center, draw_list.draws[i].bounds.radius);
+	}
+	bounds = new Buffer(gpu, slots * sizeof(glm::vec4),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	staging_ring->uploadBuffer(spheres.data(), spheres.size() * sizeof(glm::vec4), bounds->buffer, 0);
+	std::vector<uint32_t> hidden(draw_count, 0);
+	visibility = new Buffer(gpu, slots * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	staging_ring->uploadBuffer(hidden.data(), hidden.size() * sizeof(uint32_t), visibility->buffer, 0);
+
+	// a frame reads its stats back after its fence, so it has a copy of its own
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		Buffer* copy = new Buffer(gpu, sizeof(CullStats), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		void* data;
+		vkMapMemory(gpu->logical_gpu, copy->memory, 0, sizeof(CullStats), 0, &data);
+		*static_cast<CullStats*>(data) = {};
+		readback.push_back(copy);
+		readback_mapped.push_back(static_cast<CullStats*>(data));
+	}
+
+	// the source commands, the spheres, the culled commands, the counts, the
+	// visibility, the stats and the pyramid
+	cull_layout = create_set_layout(gpu, {
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER });
+
+	// the level above, or the depth buffer, and the level written
+	pyramid_layout = create_set_layout(gpu, {
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE });
+
+	std::vector<VkDescriptorSetLayout> cullLayouts = { cull_layout };
+	std::vector<VkPushConstantRange> cullConstants = { { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants) } };
+	cull_pipeline.create(gpu, "shaders/cull.comp.spv", cullLayouts, cullConstants);
+
+	std::vector<VkDescriptorSetLayout> pyramidLayouts = { pyramid_layout };
+	std::vector<VkPushConstantRange> initConstants = { { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(int32_t) } };
+	std::vector<VkPushConstantRange> noConstants;
+	pyramid_init_pipeline.create(gpu, "shaders/depth_pyramid_init.comp.spv", pyramidLayouts, initConstants);
+	pyramid_init_ms_pipeline.create(gpu, "shaders/depth_pyramid_init_ms.comp.spv", pyramidLayouts, initConstants);
+	pyramid_pipeline.create(gpu, "shaders/depth_pyramid.comp.spv", pyramidLayouts, noConstants);
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = 6;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = 1 + DEPTH_PYRAMID_MAX_LEVELS;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[2].descriptorCount = DEPTH_PYRAMID_MAX_LEVELS;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = poolSizes.size();
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1 + DEPTH_PYRAMID_MAX_LEVELS;
+	if (vkCreateDescriptorPool(gpu->logical_gpu, &poolInfo, nullptr, &descriptor_pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor pool!");
+	}
+
+	// a set for every level of the pyramid, written when the pyramid is made
+	std::vector<VkDescriptorSetLayout> setLayouts(1 + DEPTH_PYRAMID_MAX_LEVELS, pyramid_layout);
+	setLayouts[0] = cull_layout;
+	std::vector<VkDescriptorSet> sets(setLayouts.size());
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptor_pool;
+	allocInfo.descriptorSetCount = setLayouts.size();
+	allocInfo.pSetLayouts = setLayouts.data();
+	if (vkAllocateDescriptorSets(gpu->logical_gpu, &allocInfo, sets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate culling descriptor sets!");
+	}
+	cull_set = sets[0];
+	std::copy(sets.begin() + 1, sets.end(), pyramid_sets);
+
+	std::array<VkDescriptorBufferInfo, 6> bufferInfos = { {
+		{ indirect_buffer->buffer, 0, VK_WHOLE_SIZE },
+		{ bounds->buffer, 0, VK_WHOLE_SIZE },
+		{ commands->buffer, 0, VK_WHOLE_SIZE },
+		{ counts->buffer, 0, VK_WHOLE_SIZE },
+		{ visibility->buffer, 0, VK_WHOLE_SIZE },
+		{ stats_buffer->buffer, 0, VK_WHOLE_SIZE } } };
+	std::array<VkWriteDescriptorSet, 6> writes{};
+	for (uint32_t i = 0; i < writes.size(); i++) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = cull_set;
+		writes[i].dstBinding = i;
+		writes[i].dstArrayElement = 0;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].descriptorCount = 1;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+	vkUpdateDescriptorSets(gpu->logical_gpu, writes.size(), writes.data(), 0, nullptr);
+
+	// the shaders fetch texels, the sampler only has to cover every level
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = static_cast<float>(DEPTH_PYRAMID_MAX_LEVELS);
+	if (vkCreateSampler(gpu->logical_gpu, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create depth pyramid sampler!");
+	}
+}
+
+OcclusionCulling::~OcclusionCulling() {
+	vkDestroySampler(gpu->logical_gpu, sampler, nullptr);
+	vkDestroyDescriptorPool(gpu->logical_gpu, descriptor_pool, nullptr);
+	for (ComputePipeline* pipeline : { &cull_pipeline, &pyramid_init_pipeline, &pyramid_init_ms_pipeline, &pyramid_pipeline }) {
+		vkDestroyPipeline(gpu->logical_gpu, pipeline->pipeline, nullptr);
+		vkDestroyPipelineLayout(gpu->logical_gpu, pipeline->layout, nullptr);
+	}
+	vkDestroyDescriptorSetLayout(gpu->logical_gpu, cull_layout, nullptr);
+	vkDestroyDescriptorSetLayout(gpu->logical_gpu, pyramid_layout, nullptr);
+	for (Buffer* copy : readback) {
+		vkUnmapMemory(gpu->logical_gpu, copy->memory);
+		delete copy;
+	}
+	delete commands;
+	delete counts;
+	delete stats_buffer;
+	delete bounds;
+	delete visibility;
+}
+
+void OcclusionCulling::createPyramid(VkImageView depth_view, VkExtent2D extent, VkSampleCountFlagBits samples) {
+	/*
+	Every texel of the first level covers one to three pixels of the depth
+	buffer along each side, and every level after halves the one above
+	*/
+	pyramid_width = previous_power_of_two(extent.width);
+	pyramid_height = previous_power_of_two(extent.height);
+	uint32_t levels = static_cast<uint32_t>(std::log2(std::max(pyramid_width, pyramid_height))) + 1;
+	levels = std::min(levels, DEPTH_PYRAMID_MAX_LEVELS);
+	depth_samples = samples;
+
+	gpu->createImage(pyramid_width, pyramid_height, levels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, pyramid);
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(gpu->logical_gpu, pyramid, &memRequirements);
+	gpu->allocateMemory(memRequirements.size,
+		gpu->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), pyramid_memory);
+	vkBindImageMemory(gpu->logical_gpu, pyramid, pyramid_memory, 0);
+	pyramid_view = gpu->createImageView(pyramid, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, levels);
+	for (uint32_t level = 0; level < levels; level++) level_views.push_back(create_level_view(gpu, pyramid, level));
+
+	// the pyramid stays in the general layout, written and read by compute
+	// shaders only
+	VkCommandBuffer commandBuffer = gpu->beginSingleTimeCommands();
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = pyramid;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &barrier);
+	gpu->endSingleTimeCommands(commandBuffer);
+
+	// every level reads the one above, the first reads the depth buffer
+	std::vector<VkDescriptorImageInfo> sources(levels);
+	std::vector<VkDescriptorImageInfo> targets(levels);
+	std::vector<VkWriteDescriptorSet> writes;
+	for (uint32_t level = 0; level < levels; level++) {
+		sources[level].sampler = sampler;
+		sources[level].imageView = level == 0 ? depth_view : level_views[level - 1];
+		sources[level].imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+		targets[level].sampler = VK_NULL_HANDLE;
+		targets[level].imageView = level_views[level];
+		targets[level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = pyramid_sets[level];
+		write.dstArrayElement = 0;
+		write.descriptorCount = 1;
+		write.dstBinding = 0;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &sources[level];
+		writes.push_back(write);
+		write.dstBinding = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write.pImageInfo = &targets[level];
+		writes.push_back(write);
+	}
+
+	VkDescriptorImageInfo pyramidInfo{ sampler, pyramid_view, VK_IMAGE_LAYOUT_GENERAL };
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = cull_set;
+	write.dstBinding = 6;
+	write.dstArrayElement = 0;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.descriptorCount = 1;
+	write.pImageInfo = &pyramidInfo;
+	writes.push_back(write);
+	vkUpdateDescriptorSets(gpu->logical_gpu, writes.size(), writes.data(), 0, nullptr);
+}
+
+void OcclusionCulling::destroyPyramid() {
+	for (VkImageView view : level_views) vkDestroyImageView(gpu->logical_gpu, view, nullptr);
+	level_views.clear();
+	vkDestroyImageView(gpu->logical_gpu, pyramid_view, nullptr);
+	vkDestroyImage(gpu->logical_gpu, pyramid, nullptr);
+	vkFreeMemory(gpu->logical_gpu, pyramid_memory, nullptr);
+	pyramid = VK_NULL_HANDLE;
+	pyramid_memory = VK_NULL_HANDLE;
+	pyramid_view = VK_NULL_HANDLE;
+}
+
+void OcclusionCulling::readStats(uint32_t frame) {
+	stats = *readback_mapped[frame];
+}
+
+void OcclusionCulling::cull(VkCommandBuffer command_buffer, const glm::mat4& view, const glm::mat4& projection,
+	uint32_t phase) {
+	/*
+	The shader works in view space looking along +z, where the side planes
+	of a symmetric frustum only depend on P00 and P11
+	*/
+	float p00 = projection[0][0];
+	float p11 = std::abs(projection[1][1]);
+	float p22 = projection[2][2];
+	float p32 = projection[3][2];
+	float lengthX = std::sqrt(p00 * p00 + 1.0f);
+	float lengthY = std::sqrt(p11 * p11 + 1.0f);
+
+	CullConstants constants;
+	constants.view = view;
+	constants.frustum = glm::vec4(p00 / lengthX, 1.0f / lengthX, p11 / lengthY, 1.0f / lengthY);
+	constants.projection = glm::vec4(p00, p11, p22, p32);
+
+	// the near and far planes of a projection to depth 0..1, where
+	// p22 = f / (n - f) and p32 = f * n / (n - f)
+	constants.depth = glm::vec4(p32 / p22, p32 / (p22 + 1.0f), pyramid_width, pyramid_height);
+	constants.draw_count = draw_count;
+	constants.first_with_normal_map = first_with_normal_map;
+	constants.phase = phase;
+	constants.occlusion = occlusion ? 1 : 0;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline.pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline.layout, 0, 1, &cull_set, 0, nullptr);
+	vkCmdPushConstants(command_buffer, cull_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(command_buffer, group_count(draw_count, 64), 1, 1);
+}
+
+void OcclusionCulling::cullEarly(VkCommandBuffer command_buffer, const glm::mat4& view, const glm::mat4& projection) {
+
+	// the frames in flight share the buffers and the pyramid, so the last
+	// frame has to be done drawing from them and copying the stats
+	compute_barrier(command_buffer,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdFillBuffer(command_buffer, counts->buffer, 0, VK_WHOLE_SIZE, 0);
+	vkCmdFillBuffer(command_buffer, stats_buffer->buffer, 0, VK_WHOLE_SIZE, 0);
+	compute_barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	cull(command_buffer, view, projection, 0);
+	compute_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
+
+void OcclusionCulling::buildPyramid(VkCommandBuffer command_buffer) {
+	/*
+	The early render pass makes its depth available to compute shaders, every
+	level waits for the one above
+	*/
+	bool multisampled = depth_samples != VK_SAMPLE_COUNT_1_BIT;
+	const ComputePipeline& init = multisampled ? pyramid_init_ms_pipeline : pyramid_init_pipeline;
+	int32_t samples = depth_samples;
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, init.pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, init.layout, 0, 1, &pyramid_sets[0], 0, nullptr);
+	vkCmdPushConstants(command_buffer, init.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(samples), &samples);
+	vkCmdDispatch(command_buffer, group_count(pyramid_width, 8), group_count(pyramid_height, 8), 1);
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid_pipeline.pipeline);
+	for (uint32_t level = 1; level < level_views.size(); level++) {
+		compute_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid_pipeline.layout, 0, 1,
+			&pyramid_sets[level], 0, nullptr);
+		uint32_t width = std::max(pyramid_width >> level, 1u);
+		uint32_t height = std::max(pyramid_height >> level, 1u);
+		vkCmdDispatch(command_buffer, group_count(width, 8), group_count(height, 8), 1);
+	}
+	compute_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+void OcclusionCulling::cullLate(VkCommandBuffer command_buffer, const glm::mat4& view, const glm::mat4& projection,
+	uint32_t frame) {
+
+	// the early draws read the counts and the commands before the late phase
+	// clears the counts and compacts its commands from the first slot of each
+	// range again, over the ones the early phase wrote
+	compute_barrier(command_buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+	vkCmdFillBuffer(command_buffer, counts->buffer, 0, VK_WHOLE_SIZE, 0);
+	compute_barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	cull(command_buffer, view, projection, 1);
+	compute_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+
+	// read on the host once the fence of the frame is signaled, a frame or
+	// two after the draws it counts
+	VkBufferCopy copy{ 0, 0, sizeof(CullStats) };
+	vkCmdCopyBuffer(command_buffer, stats_buffer->buffer, readback[frame]->buffer, 1, &copy);
+	compute_barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <vector>
+
+#include "parallel.h"
+
+int get_num_workers() {
+	int num_workers = std::thread::hardware_concurrency();
+	if (num_workers < 1) num_workers = 1;
+	return num_workers;
+}
+
+void parallel_for(int count, std::function<void(int)> task) {
+	/*
+	Hand out the task indices to a group of worker threads.
+	The first exception thrown by a task is rethrown on the calling thread.
+	*/
+
+	if (count <= 0) return;
+
+	// do small jobs on the calling thread
+	int num_threads = std::min(get_num_workers(), count);
+	if (num_threads == 1) {
+		for (int i = 0; i < count; i++) task(i);
+		return;
+	}
+
+	std::atomic<int> next_index(0);
+	std::exception_ptr exception = nullptr;
+	std::mutex exception_mutex;
+
+	// each worker takes the next index until there is none left
+	auto worker = [&]() {
+		while (true) {
+			int i = next_index.fetch_add(1);
+			if (i >= count) return;
+			try {
+				task(i);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(exception_mutex);
+				if (!exception) exception = std::current_exception();
+				next_index = count;
+			}
+		}
+	};
+
+	// the calling thread is one of the workers
+	std::vector<std::thread> threads;
+	for (int i = 1; i < num_threads; i++) threads.emplace_back(worker);
+	worker();
+	for (int i = 0; i < threads.size(); i++) threads[i].join();
+
+	if (exception) std::rethrow_exception(exception);
+}
\ No newline at end of file
@@ -14,7 +14,8 @@ void Pipeline::create(
     std::string vertex_shader, std::string fragment_shader,
     VkVertexInputBindingDescription bindingDescription,
     std::vector<VkVertexInputAttributeDescription> attributeDescriptions,
-    std::vector<VkDescriptorSetLayout>& setLayouts
+    std::vector<VkDescriptorSetLayout>& setLayouts,
+    std::vector<VkPushConstantRange>& pushConstantRanges
 ) {
     auto vertShaderCode = readFile(vertex_shader);
     auto fragShaderCode = readFile(fragment_shader);
@@ -98,7 +99,8 @@ void Pipeline::create(
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = setLayouts.size();
     pipelineLayoutInfo.pSetLayouts = setLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantRanges.size();
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
 
     if (vkCreatePipelineLayout(gpu->logical_gpu, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
@@ -137,6 +139,46 @@ void Pipeline::create(
     vkDestroyShaderModule(gpu->logical_gpu, vertShaderModule, nullptr);
 }
 
+ComputePipeline::ComputePipeline() {
+	pipeline = VK_NULL_HANDLE;
+	layout = VK_NULL_HANDLE;
+}
+
+void ComputePipeline::create(
+    GPU* gpu, std::string compute_shader,
+    std::vector<VkDescriptorSetLayout>& setLayouts,
+    std::vector<VkPushConstantRange>& pushConstantRanges
+) {
+    auto compShaderCode = readFile(compute_shader);
+    VkShaderModule compShaderModule = gpu->createShaderModule(compShaderCode);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = setLayouts.size();
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantRanges.size();
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+    if (vkCreatePipelineLayout(gpu->logical_gpu, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = layout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    if (vkCreateComputePipelines(gpu->logical_gpu, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+
+    vkDestroyShaderModule(gpu->logical_gpu, compShaderModule, nullptr);
+}
+
 std::vector<char> readFile(const std::string& filename) {
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cmath>
+
+#include "parallel.h"
+#include "scene_bvh.h"
+#include "sm_math.h"
+
+// the meshes with at least this many triangles are built one at a time on
+// all the cores, the others are built on a core each
+static const uint32_t LARGE_MESH_TRIANGLES = 1 << 18;
+
+const MeshBase& scene_mesh(const Scene& scene, int mesh) {
+	if (mesh < scene.meshes.size()) return scene.meshes[mesh];
+	return scene.meshes_with_normal_map[mesh - scene.meshes.size()];
+}
+
+TriangleMesh mesh_triangles(const Scene& scene, int mesh) {
+	const MeshBase& base = scene_mesh(scene, mesh);
+	TriangleMesh triangles;
+	if (mesh < scene.meshes.size()) {
+		triangles.vertices = reinterpret_cast<const char*>(&scene.vertices.data()[base.vertex_offset].pos);
+		triangles.vertex_stride = sizeof(Vertex);
+	} else {
+		triangles.vertices = reinterpret_cast<const char*>(&scene.vertices_with_tangent.data()[base.vertex_offset].pos);
+		triangles.vertex_stride = sizeof(VertexWithTangent);
+	}
+	triangles.indices = scene.indices.data() + base.index_offset;
+	triangles.triangle_count = base.index_count / 3;
+	return triangles;
+}
+
+void build_scene_bvh(Scene* scene) {
+	int mesh_count = scene->meshes.size() + scene->meshes_with_normal_map.size();
+	std::vector<BvhBox> boxes(mesh_count);
+	std::vector<int> small_meshes;
+	std::vector<int> large_meshes;
+	for (int i = 0; i < mesh_count; i++) {
+		const MeshBase& mesh = scene_mesh(*scene, i);
+		boxes[i] = { mesh.bounds.aabb_min, mesh.bounds.aabb_max };
+		if (mesh.index_count / 3 >= LARGE_MESH_TRIANGLES) large_meshes.push_back(i);
+		else small_meshes.push_back(i);
+	}
+	scene->bvh.top = build_bvh(boxes, true);
+
+	scene->bvh.bottom.resize(mesh_count);
+	for (int i : large_meshes) {
+		scene->bvh.bottom[i] = build_bvh(triangle_boxes(mesh_triangles(*scene, i)), true);
+	}
+	parallel_for(small_meshes.size(), [&](int i) {
+		int mesh = small_meshes[i];
+		scene->bvh.bottom[mesh] = build_bvh(triangle_boxes(mesh_triangles(*scene, mesh)), false);
+	});
+	set_bvh_transforms(scene);
+}
+
+void set_bvh_transforms(Scene* scene) {
+	int mesh_count = scene->meshes.size() + scene->meshes_with_normal_map.size();
+	scene->bvh.world_to_mesh.resize(mesh_count);
+	for (int i = 0; i < mesh_count; i++) {
+		scene->bvh.world_to_mesh[i] = glm::inverse(scene_mesh(*scene, i).init_transform);
+	}
+}
+
+bool intersect_scene(const Scene& scene, const Ray& ray, float t_max, RayHit& hit) {
+	/*
+	Walk the top level nearest first and the bottom level of every mesh the
+	ray enters, the nearest hit so far skips the meshes behind it
+	*/
+	hit.mesh = -1;
+	traverse_bvh(scene.bvh.top, ray, t_max, [&](uint32_t mesh, float& t_nearest) {
+		const glm::mat4& world_to_mesh = scene.bvh.world_to_mesh[mesh];
+		Ray mesh_ray(
+			glm::vec3(world_to_mesh * glm::vec4(ray.origin, 1.0f)),
+			glm::vec3(world_to_mesh * glm::vec4(ray.direction, 0.0f))
+		);
+		uint32_t triangle;
+		if (intersect_triangles(scene.bvh.bottom[mesh], mesh_triangles(scene, mesh), mesh_ray, t_nearest, triangle)) {
+			hit.mesh = mesh;
+			hit.triangle = triangle;
+		}
+	});
+	if (hit.mesh == -1) return false;
+	hit.t = t_max;
+
+	// normals go to world space with the transpose of the inverse
+	TriangleMesh triangles = mesh_triangles(scene, hit.mesh);
+	const uint32_t* corners = triangles.indices + 3 * hit.triangle;
+	glm::vec3 a = triangles.position(corners[0]);
+	glm::vec3 normal = glm::cross(triangles.position(corners[1]) - a, triangles.position(corners[2]) - a);
+	const glm::mat4& world_to_mesh = scene.bvh.world_to_mesh[hit.mesh];
+	normal = glm::vec3(
+		glm::dot(glm::vec3(world_to_mesh[0]), normal),
+		glm::dot(glm::vec3(world_to_mesh[1]), normal),
+		glm::dot(glm::vec3(world_to_mesh[2]), normal)
+	);
+	float length = glm::length(normal);
+	hit.normal = length > 0.0f ? normal / length : -ray.direction;
+	if (glm::dot(hit.normal, ray.direction) > 0.0f) hit.normal = -hit.normal;
+	return true;
+}
+
+uint32_t cull_scene(const Scene& scene, const glm::mat4& view_projection, std::vector<uint8_t>& visible) {
+	/*
+	Every node is tested against the planes its parent was not fully inside
+	of. A node fully inside all the planes takes its whole range of meshes
+	without testing them, a node fully behind one plane drops it.
+	*/
+	glm::vec4 planes[6];
+	frustum_planes(view_projection, planes);
+	const Bvh& top = scene.bvh.top;
+	visible.assign(scene.meshes.size() + scene.meshes_with_normal_map.size(), 0);
+	if (top.nodes.empty()) return 0;
+
+	// returns the planes the box is not fully inside of, or -1 when it is
+	// fully outside one of them
+	auto classify = [&](glm::vec3 low, glm::vec3 high, int plane_mask) {
+		glm::vec3 center = (low + high) * 0.5f;
+		glm::vec3 extent = (high - low) * 0.5f;
+		for (int i = 0; i < 6; i++) {
+			if (!(plane_mask >> i & 1)) continue;
+			glm::vec3 normal = glm::vec3(planes[i]);
+			float distance = glm::dot(normal, center) + planes[i].w;
+			float radius = glm::dot(glm::abs(normal), extent);
+			if (distance + radius < 0.0f) return -1;
+			if (distance - radius >= 0.0f) plane_mask &= ~(1 << i);
+		}
+		return plane_mask;
+	};
+
+	uint32_t stack[BVH_MAX_DEPTH + 1];
+	int stack_masks[BVH_MAX_DEPTH + 1];
+	uint32_t stack_size = 0;
+	uint32_t visited = 0;
+	stack[stack_size] = 0;
+	stack_masks[stack_size++] = 0x3f;
+	while (stack_size > 0) {
+		stack_size--;
+		const BvhNode& node = top.nodes[stack[stack_size]];
+		int plane_mask = classify(node.aabb_min, node.aabb_max, stack_masks[stack_size]);
+		visited++;
+		if (plane_mask == -1) continue;
+
+		if (plane_mask == 0) {
+
+			// the meshes of a subtree are the range from its leftmost to its
+			// rightmost leaf
+			const BvhNode* leftmost = &node;
+			const BvhNode* rightmost = &node;
+			while (leftmost->count == 0) leftmost = &top.nodes[leftmost->first];
+			while (rightmost->count == 0) rightmost = &top.nodes[rightmost->first + 1];
+			for (uint32_t i = leftmost->first; i < rightmost->first + rightmost->count; i++) visible[top.indices[i]] = 1;
+		} else if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				const MeshBounds& bounds = scene_mesh(scene, top.indices[i]).bounds;
+				if (classify(bounds.aabb_min, bounds.aabb_max, plane_mask) != -1) visible[top.indices[i]] = 1;
+			}
+		} else {
+			stack[stack_size] = node.first + 1;
+			stack_masks[stack_size++] = plane_mask;
+			stack[stack_size] = node.first;
+			stack_masks[stack_size++] = plane_mask;
+		}
+	}
+	return visited;
+}
+
+glm::vec3 collide_movement(const Scene& scene, glm::vec3 from, glm::vec3 to, float radius) {
+	/*
+	Move until radius before the first hit, then move what is left of the
+	way along the surface that was hit, a few times for corners
+	*/
+	glm::vec3 position = from;
+	glm::vec3 movement = to - from;
+	for (int bounce = 0; bounce < 3; bounce++) {
+		float distance = glm::length(movement);
+		if (distance < 1e-6f) break;
+		glm::vec3 direction = movement / distance;
+		RayHit hit;
+		if (!intersect_scene(scene, Ray(position, direction), distance + radius, hit)) {
+			position += movement;
+			break;
+		}
+		float travel = std::max(hit.t - radius, 0.0f);
+		position += direction * travel;
+		glm::vec3 rest = direction * (distance - travel);
+		movement = rest - hit.normal * glm::dot(rest, hit.normal);
+	}
+	return position;
+}
\ No newline at end of file
@@ -0,0 +1,579 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "geometry_codec.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "scene_bvh.h"
+#include "scene_cache.h"
+#include "timer.h"
+
+static const char SCENE_CACHE_MAGIC[8] = { 'S', 'M', 'S', 'C', 'E', 'N', 'E', '\0' };
+
+// copy the large sections in pieces of this size so they are spread over the cores
+static const uint64_t COPY_PIECE_SIZE = 4 << 20;
+
+struct SectionSource {
+	uint32_t id;
+	uint32_t element_size;
+	const void* data;
+	uint64_t count;
+};
+
+struct SceneCacheSnapshot {
+	/*
+	A copy of everything a cache is written from, so it can be written while
+	the scene is used
+	*/
+	std::vector<Vertex> vertices;
+	std::vector<VertexWithTangent> vertices_with_tangent;
+	std::vector<uint32_t> indices;
+	std::vector<SceneCacheMesh> meshes;
+	std::vector<SceneCacheMesh> meshes_with_normal_map;
+	std::vector<SceneCacheString> textures;
+	std::vector<SceneCacheString> normal_maps;
+	std::vector<SceneCacheString> debug_node_names;
+	std::vector<SceneCacheSource> sources;
+	std::vector<uint64_t> mesh_signatures;
+	std::vector<BvhNode> bvh_nodes;
+	std::vector<uint32_t> bvh_indices;
+	std::vector<SceneCacheBvh> bvh_trees;
+	std::string strings;
+	uint32_t loader_version;
+	bool compress;
+};
+
+struct CopyPiece {
+	char* destination;
+	const char* source;
+	uint64_t size;
+};
+
+struct CacheWriter {
+	/*
+	The thread writing the cache in the background, joined at exit at the
+	latest
+	*/
+	std::thread thread;
+
+	~CacheWriter() {
+		if (thread.joinable()) thread.join();
+	}
+};
+
+static CacheWriter cache_writer;
+
+static uint64_t align_up(uint64_t offset) {
+	return (offset + SCENE_CACHE_ALIGNMENT - 1) / SCENE_CACHE_ALIGNMENT * SCENE_CACHE_ALIGNMENT;
+}
+
+static SceneCacheString add_string(std::string& strings, const std::string& s) {
+	SceneCacheString cache_string = { strings.size(), s.size() };
+	strings += s;
+	return cache_string;
+}
+
+static SceneCacheMesh to_cache_mesh(const MeshBase& mesh, int normal_map_index, std::string& strings) {
+	SceneCacheMesh cache_mesh;
+	cache_mesh.init_transform = mesh.init_transform;
+	cache_mesh.index_offset = mesh.index_offset;
+	cache_mesh.index_count = mesh.index_count;
+	cache_mesh.vertex_offset = mesh.vertex_offset;
+	cache_mesh.vertex_count = mesh.vertex_count;
+	cache_mesh.texture_index = mesh.texture_index;
+	cache_mesh.normal_map_index = normal_map_index;
+	cache_mesh.debug_node_name = add_string(strings, mesh.debug_node_name);
+	cache_mesh.bounds = mesh.bounds;
+	return cache_mesh;
+}
+
+static void from_cache_mesh(const SceneCacheMesh& cache_mesh, const char* strings, MeshBase& mesh) {
+	mesh.init_transform = cache_mesh.init_transform;
+	mesh.index_offset = cache_mesh.index_offset;
+	mesh.index_count = cache_mesh.index_count;
+	mesh.vertex_offset = cache_mesh.vertex_offset;
+	mesh.vertex_count = cache_mesh.vertex_count;
+	mesh.texture_index = cache_mesh.texture_index;
+	mesh.debug_node_name.assign(strings + cache_mesh.debug_node_name.offset, cache_mesh.debug_node_name.size);
+	mesh.bounds = cache_mesh.bounds;
+}
+
+static int64_t get_modified_time(std::string path) {
+	return std::filesystem::last_write_time(path).time_since_epoch().count();
+}
+
+static uint64_t hash_file(std::string path) {
+	MappedFile file(path);
+	return hash_bytes_parallel(file.data, file.size);
+}
+
+SourceFile describe_source_file(std::string path) {
+	SourceFile source;
+	source.path = path;
+	source.size = std::filesystem::file_size(path);
+	source.modified_time = get_modified_time(path);
+	source.hash = hash_file(path);
+	return source;
+}
+
+bool source_file_unchanged(const SourceFile& source) {
+	std::error_code error;
+	uint64_t size = std::filesystem::file_size(source.path, error);
+	if (error || size != source.size) return false;
+	if (get_modified_time(source.path) == source.modified_time) return true;
+
+	// touched or copied, compare the contents
+	return hash_file(source.path) == source.hash;
+}
+
+static std::shared_ptr<SceneCacheSnapshot> take_snapshot(
+	Scene* scene,
+	const SceneCacheInfo& info,
+	bool compress
+) {
+	/*
+	Copy the geometry and gather the records and the strings of the scene
+	*/
+	std::shared_ptr<SceneCacheSnapshot> snapshot = std::make_shared<SceneCacheSnapshot>();
+	snapshot->vertices = scene->vertices;
+	snapshot->vertices_with_tangent = scene->vertices_with_tangent;
+	snapshot->indices = scene->indices;
+	snapshot->compress = compress;
+	snapshot->loader_version = info.loader_version;
+	snapshot->mesh_signatures = info.mesh_signatures;
+
+	std::string& strings = snapshot->strings;
+	snapshot->meshes.reserve(scene->meshes.size());
+	for (int i = 0; i < scene->meshes.size(); i++) {
+		snapshot->meshes.push_back(to_cache_mesh(scene->meshes[i], -1, strings));
+	}
+	snapshot->meshes_with_normal_map.reserve(scene->meshes_with_normal_map.size());
+	for (int i = 0; i < scene->meshes_with_normal_map.size(); i++) {
+		MeshWithNormalMap& mesh = scene->meshes_with_normal_map[i];
+		snapshot->meshes_with_normal_map.push_back(to_cache_mesh(mesh, mesh.normal_map_index, strings));
+	}
+	for (int i = 0; i < scene->textures.size(); i++) {
+		snapshot->textures.push_back(add_string(strings, scene->textures[i].file_path));
+	}
+	for (int i = 0; i < scene->normal_maps.size(); i++) {
+		snapshot->normal_maps.push_back(add_string(strings, scene->normal_maps[i].file_path));
+	}
+	for (int i = 0; i < scene->debug_node_names.size(); i++) {
+		snapshot->debug_node_names.push_back(add_string(strings, scene->debug_node_names[i]));
+	}
+	for (int i = 0; i < info.sources.size(); i++) {
+		const SourceFile& source = info.sources[i];
+		snapshot->sources.push_back({ add_string(strings, source.path), source.size, source.modified_time, source.hash });
+	}
+
+	// the top level, then the bottom levels
+	auto add_bvh = [&](const Bvh& bvh) {
+		snapshot->bvh_trees.push_back({ snapshot->bvh_nodes.size(), bvh.nodes.size(),
+			snapshot->bvh_indices.size(), bvh.indices.size() });
+		snapshot->bvh_nodes.insert(snapshot->bvh_nodes.end(), bvh.nodes.begin(), bvh.nodes.end());
+		snapshot->bvh_indices.insert(snapshot->bvh_indices.end(), bvh.indices.begin(), bvh.indices.end());
+	};
+	add_bvh(scene->bvh.top);
+	for (const Bvh& bvh : scene->bvh.bottom) add_bvh(bvh);
+	return snapshot;
+}
+
+static void write_snapshot(const SceneCacheSnapshot& snapshot, std::string path) {
+	/*
+	Lay out every section at an aligned offset behind the header and the
+	section directory, then write them in one pass
+	*/
+	std::vector<SectionSource> sections = {
+		{ SECTION_VERTICES, sizeof(Vertex), snapshot.vertices.data(), snapshot.vertices.size() },
+		{ SECTION_VERTICES_WITH_TANGENT, sizeof(VertexWithTangent),
+			snapshot.vertices_with_tangent.data(), snapshot.vertices_with_tangent.size() },
+		{ SECTION_INDICES, sizeof(uint32_t), snapshot.indices.data(), snapshot.indices.size() },
+		{ SECTION_MESHES, sizeof(SceneCacheMesh), snapshot.meshes.data(), snapshot.meshes.size() },
+		{ SECTION_MESHES_WITH_NORMAL_MAP, sizeof(SceneCacheMesh),
+			snapshot.meshes_with_normal_map.data(), snapshot.meshes_with_normal_map.size() },
+		{ SECTION_TEXTURES, sizeof(SceneCacheString), snapshot.textures.data(), snapshot.textures.size() },
+		{ SECTION_NORMAL_MAPS, sizeof(SceneCacheString), snapshot.normal_maps.data(), snapshot.normal_maps.size() },
+		{ SECTION_DEBUG_NODE_NAMES, sizeof(SceneCacheString),
+			snapshot.debug_node_names.data(), snapshot.debug_node_names.size() },
+		{ SECTION_SOURCES, sizeof(SceneCacheSource), snapshot.sources.data(), snapshot.sources.size() },
+		{ SECTION_MESH_SIGNATURES, sizeof(uint64_t), snapshot.mesh_signatures.data(), snapshot.mesh_signatures.size() },
+		{ SECTION_BVH_NODES, sizeof(BvhNode), snapshot.bvh_nodes.data(), snapshot.bvh_nodes.size() },
+		{ SECTION_BVH_INDICES, sizeof(uint32_t), snapshot.bvh_indices.data(), snapshot.bvh_indices.size() },
+		{ SECTION_BVH_TREES, sizeof(SceneCacheBvh), snapshot.bvh_trees.data(), snapshot.bvh_trees.size() },
+		{ SECTION_STRINGS, 1, snapshot.strings.data(), snapshot.strings.size() }
+	};
+
+	// replace the raw geometry with the encoded one
+	std::vector<char> encoded_vertices;
+	std::vector<char> encoded_vertices_with_tangent;
+	std::vector<char> encoded_indices;
+	if (snapshot.compress) {
+		encode_vertices(snapshot.vertices.data(), snapshot.vertices.size(), encoded_vertices);
+		encode_vertices(snapshot.vertices_with_tangent.data(), snapshot.vertices_with_tangent.size(), encoded_vertices_with_tangent);
+		encode_indices(snapshot.indices.data(), snapshot.indices.size(), encoded_indices);
+		sections[0] = { SECTION_VERTICES_ENCODED, 1, encoded_vertices.data(), encoded_vertices.size() };
+		sections[1] = { SECTION_VERTICES_WITH_TANGENT_ENCODED, 1,
+			encoded_vertices_with_tangent.data(), encoded_vertices_with_tangent.size() };
+		sections[2] = { SECTION_INDICES_ENCODED, 1, encoded_indices.data(), encoded_indices.size() };
+	}
+
+	// lay out the file
+	SceneCacheHeader header;
+	memset(&header, 0, sizeof(SceneCacheHeader));
+	memcpy(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = SCENE_CACHE_VERSION;
+	header.section_count = sections.size();
+	header.vertex_size = sizeof(Vertex);
+	header.vertex_with_tangent_size = sizeof(VertexWithTangent);
+	header.loader_version = snapshot.loader_version;
+	std::vector<SceneCacheSection> directory(sections.size());
+	uint64_t offset = align_up(sizeof(SceneCacheHeader) + sections.size() * sizeof(SceneCacheSection));
+	for (int i = 0; i < sections.size(); i++) {
+		directory[i].id = sections[i].id;
+		directory[i].element_size = sections[i].element_size;
+		directory[i].offset = offset;
+		directory[i].count = sections[i].count;
+		directory[i].size = sections[i].count * sections[i].element_size;
+		offset = align_up(offset + directory[i].size);
+	}
+	header.file_size = offset;
+
+	// write the file
+	std::ofstream file(path, std::ofstream::binary | std::ofstream::out | std::ofstream::trunc);
+	if (file.fail()) throw std::runtime_error("failed to create " + path);
+	file.write(reinterpret_cast<char*>(&header), sizeof(SceneCacheHeader));
+	file.write(reinterpret_cast<char*>(directory.data()), directory.size() * sizeof(SceneCacheSection));
+	uint64_t position = sizeof(SceneCacheHeader) + directory.size() * sizeof(SceneCacheSection);
+	const char padding[SCENE_CACHE_ALIGNMENT] = {};
+	for (int i = 0; i < sections.size(); i++) {
+		file.write(padding, directory[i].offset - position);
+		file.write(static_cast<const char*>(sections[i].data), directory[i].size);
+		position = directory[i].offset + directory[i].size;
+	}
+	file.write(padding, header.file_size - position);
+	file.close();
+	if (file.fail()) throw std::runtime_error("failed to write " + path);
+}
+
+static void write_snapshot_atomically(const SceneCacheSnapshot& snapshot, std::string cache_path) {
+	/*
+	Write next to the cache and rename over it, so the cache is either the
+	old or the new file and never a partly written one
+	*/
+	std::string temp_path = cache_path + ".tmp";
+	try {
+		write_snapshot(snapshot, temp_path);
+		std::filesystem::rename(temp_path, cache_path);
+	} catch (...) {
+		std::error_code error;
+		std::filesystem::remove(temp_path, error);
+		throw;
+	}
+}
+
+void start_scene_cache_write(Scene* scene, const SceneCacheInfo& info, std::string cache_path, bool compress) {
+	finish_scene_cache_write();
+	std::shared_ptr<SceneCacheSnapshot> snapshot = take_snapshot(scene, info, compress);
+	cache_writer.thread = std::thread([snapshot, cache_path]() {
+		// the cache only makes the next start faster, so a failure is reported and ignored
+		Timer timer;
+		try {
+			write_snapshot_atomically(*snapshot, cache_path);
+			std::cout << "wrote " << cache_path << " in " << timer.lap() << " ms" << std::endl;
+		} catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+		}
+	});
+}
+
+void finish_scene_cache_write() {
+	if (cache_writer.thread.joinable()) cache_writer.thread.join();
+}
+
+static const SceneCacheSection* find_section(
+	const SceneCacheSection* directory,
+	uint32_t section_count,
+	uint64_t file_size,
+	uint32_t id,
+	uint32_t element_size
+) {
+	/*
+	Find a section and check that it fits in the file, nullptr if it doesn't
+	*/
+	for (uint32_t i = 0; i < section_count; i++) {
+		const SceneCacheSection& section = directory[i];
+		if (section.id != id) continue;
+		if (section.element_size != element_size) return nullptr;
+		if (section.offset % SCENE_CACHE_ALIGNMENT != 0) return nullptr;
+		if (section.count > file_size / element_size) return nullptr;
+		if (section.size != section.count * element_size) return nullptr;
+		if (section.offset > file_size || section.size > file_size - section.offset) return nullptr;
+		return &section;
+	}
+	return nullptr;
+}
+
+static const SceneCacheSection* find_geometry_section(
+	const SceneCacheSection* directory,
+	uint32_t section_count,
+	uint64_t file_size,
+	uint32_t id,
+	uint32_t encoded_id,
+	uint32_t element_size
+) {
+	/*
+	The raw section of a geometry stream, or its encoded section if the cache
+	is compressed
+	*/
+	const SceneCacheSection* section = find_section(directory, section_count, file_size, id, element_size);
+	if (section == nullptr) section = find_section(directory, section_count, file_size, encoded_id, 1);
+	return section;
+}
+
+static bool is_encoded(const SceneCacheSection& section) {
+	return section.element_size == 1;
+}
+
+static bool geometry_count(const char* data, const SceneCacheSection& section, uint64_t& count) {
+	if (!is_encoded(section)) {
+		count = section.count;
+		return true;
+	}
+
+	// every encoded value takes at least a byte
+	return encoded_count(data + section.offset, section.size, count) && count <= section.size;
+}
+
+static bool valid_string(const SceneCacheString& s, uint64_t strings_size) {
+	return s.offset <= strings_size && s.size <= strings_size - s.offset;
+}
+
+static bool valid_mesh(const SceneCacheMesh& mesh, uint64_t num_vertices, uint64_t num_indices, uint64_t strings_size) {
+	return mesh.vertex_offset <= num_vertices && mesh.vertex_count <= num_vertices - mesh.vertex_offset &&
+		mesh.index_offset <= num_indices && mesh.index_count <= num_indices - mesh.index_offset &&
+		mesh.index_count % 3 == 0 && valid_string(mesh.debug_node_name, strings_size);
+}
+
+static bool valid_indices(const SceneCacheMesh& mesh, const uint32_t* indices) {
+	for (uint64_t i = mesh.index_offset; i < mesh.index_offset + mesh.index_count; i++) {
+		if (indices[i] >= mesh.vertex_count) return false;
+	}
+	return true;
+}
+
+static bool valid_material(const SceneCacheMesh& mesh, uint64_t num_textures, uint64_t num_normal_maps) {
+	return mesh.texture_index >= -1 && (mesh.texture_index == -1 || uint64_t(mesh.texture_index) < num_textures) &&
+		mesh.normal_map_index >= -1 && (mesh.normal_map_index == -1 || uint64_t(mesh.normal_map_index) < num_normal_maps);
+}
+
+static bool valid_bvh_range(const SceneCacheBvh& tree, uint64_t num_nodes, uint64_t num_indices) {
+	return tree.node_offset <= num_nodes && tree.node_count <= num_nodes - tree.node_offset &&
+		tree.index_offset <= num_indices && tree.index_count <= num_indices - tree.index_offset;
+}
+
+bool read_scene_cache(Scene* scene, SceneCacheInfo& info, std::string cache_path) {
+	/*
+	Map the cache, check the header and every range in it, then copy the
+	sections straight into the scene. The large sections are copied in
+	pieces on all the cores, encoded geometry is decoded block by block on
+	all the cores.
+	*/
+
+	MappedFile file(cache_path);
+
+	// check the header
+	if (file.size < sizeof(SceneCacheHeader)) return false;
+	SceneCacheHeader header;
+	memcpy(&header, file.data, sizeof(SceneCacheHeader));
+	if (memcmp(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic)) != 0) return false;
+	if (header.version != SCENE_CACHE_VERSION) return false;
+	if (header.file_size != file.size) return false;
+	if (header.vertex_size != sizeof(Vertex)) return false;
+	if (header.vertex_with_tangent_size != sizeof(VertexWithTangent)) return false;
+	if (header.section_count > (file.size - sizeof(SceneCacheHeader)) / sizeof(SceneCacheSection)) return false;
+	const SceneCacheSection* directory =
+		reinterpret_cast<const SceneCacheSection*>(file.data + sizeof(SceneCacheHeader));
+
+	// find the sections
+	const SceneCacheSection* sections[] = {
+		find_geometry_section(directory, header.section_count, file.size,
+			SECTION_VERTICES, SECTION_VERTICES_ENCODED, sizeof(Vertex)),
+		find_geometry_section(directory, header.section_count, file.size,
+			SECTION_VERTICES_WITH_TANGENT, SECTION_VERTICES_WITH_TANGENT_ENCODED, sizeof(VertexWithTangent)),
+		find_geometry_section(directory, header.section_count, file.size,
+			SECTION_INDICES, SECTION_INDICES_ENCODED, sizeof(uint32_t)),
+		find_section(directory, header.section_count, file.size, SECTION_MESHES, sizeof(SceneCacheMesh)),
+		find_section(directory, header.section_count, file.size, SECTION_MESHES_WITH_NORMAL_MAP, sizeof(SceneCacheMesh)),
+		find_section(directory, header.section_count, file.size, SECTION_TEXTURES, sizeof(SceneCacheString)),
+		find_section(directory, header.section_count, file.size, SECTION_NORMAL_MAPS, sizeof(SceneCacheString)),
+		find_section(directory, header.section_count, file.size, SECTION_DEBUG_NODE_NAMES, sizeof(SceneCacheString)),
+		find_section(directory, header.section_count, file.size, SECTION_STRINGS, 1),
+		find_section(directory, header.section_count, file.size, SECTION_SOURCES, sizeof(SceneCacheSource)),
+		find_section(directory, header.section_count, file.size, SECTION_MESH_SIGNATURES, sizeof(uint64_t)),
+		find_section(directory, header.section_count, file.size, SECTION_BVH_NODES, sizeof(BvhNode)),
+		find_section(directory, header.section_count, file.size, SECTION_BVH_INDICES, sizeof(uint32_t)),
+		find_section(directory, header.section_count, file.size, SECTION_BVH_TREES, sizeof(SceneCacheBvh))
+	};
+	for (const SceneCacheSection* section : sections) {
+		if (section == nullptr) return false;
+	}
+	const SceneCacheSection& vertices = *sections[0];
+	const SceneCacheSection& vertices_with_tangent = *sections[1];
+	const SceneCacheSection& indices = *sections[2];
+	const SceneCacheMesh* meshes = reinterpret_cast<const SceneCacheMesh*>(file.data + sections[3]->offset);
+	const SceneCacheMesh* meshes_with_normal_map = reinterpret_cast<const SceneCacheMesh*>(file.data + sections[4]->offset);
+	const SceneCacheString* textures = reinterpret_cast<const SceneCacheString*>(file.data + sections[5]->offset);
+	const SceneCacheString* normal_maps = reinterpret_cast<const SceneCacheString*>(file.data + sections[6]->offset);
+	const SceneCacheString* debug_node_names = reinterpret_cast<const SceneCacheString*>(file.data + sections[7]->offset);
+	const char* strings = file.data + sections[8]->offset;
+	uint64_t strings_size = sections[8]->size;
+	const SceneCacheSource* sources = reinterpret_cast<const SceneCacheSource*>(file.data + sections[9]->offset);
+	const uint64_t* mesh_signatures = reinterpret_cast<const uint64_t*>(file.data + sections[10]->offset);
+	const BvhNode* bvh_nodes = reinterpret_cast<const BvhNode*>(file.data + sections[11]->offset);
+	const uint32_t* bvh_indices = reinterpret_cast<const uint32_t*>(file.data + sections[12]->offset);
+	const SceneCacheBvh* bvh_trees = reinterpret_cast<const SceneCacheBvh*>(file.data + sections[13]->offset);
+	uint64_t num_vertices;
+	uint64_t num_vertices_with_tangent;
+	uint64_t num_indices;
+	if (!geometry_count(file.data, vertices, num_vertices)) return false;
+	if (!geometry_count(file.data, vertices_with_tangent, num_vertices_with_tangent)) return false;
+	if (!geometry_count(file.data, indices, num_indices)) return false;
+
+	// check every range before touching the scene
+	for (uint64_t i = 0; i < sections[3]->count; i++) {
+		if (!valid_mesh(meshes[i], num_vertices, num_indices, strings_size)) return false;
+		if (!valid_material(meshes[i], sections[5]->count, sections[6]->count)) return false;
+	}
+	for (uint64_t i = 0; i < sections[4]->count; i++) {
+		if (!valid_mesh(meshes_with_normal_map[i], num_vertices_with_tangent, num_indices, strings_size)) return false;
+		if (!valid_material(meshes_with_normal_map[i], sections[5]->count, sections[6]->count)) return false;
+		if (meshes_with_normal_map[i].normal_map_index == -1) return false;
+	}
+	for (int section = 5; section <= 7; section++) {
+		const SceneCacheString* cache_strings = reinterpret_cast<const SceneCacheString*>(file.data + sections[section]->offset);
+		for (uint64_t i = 0; i < sections[section]->count; i++) {
+			if (!valid_string(cache_strings[i], strings_size)) return false;
+		}
+	}
+	for (uint64_t i = 0; i < sections[9]->count; i++) {
+		if (!valid_string(sources[i].path, strings_size)) return false;
+	}
+	if (sections[10]->count != sections[3]->count + sections[4]->count) return false;
+	if (sections[13]->count != 1 + sections[3]->count + sections[4]->count) return false;
+	for (uint64_t i = 0; i < sections[13]->count; i++) {
+		if (!valid_bvh_range(bvh_trees[i], sections[11]->count, sections[12]->count)) return false;
+	}
+
+	// copy the bvh and check the trees
+	SceneBvh bvh;
+	auto copy_bvh = [&](const SceneCacheBvh& tree, Bvh& destination) {
+		destination.nodes.assign(bvh_nodes + tree.node_offset, bvh_nodes + tree.node_offset + tree.node_count);
+		destination.indices.assign(bvh_indices + tree.index_offset, bvh_indices + tree.index_offset + tree.index_count);
+	};
+	copy_bvh(bvh_trees[0], bvh.top);
+	if (!valid_bvh(bvh.top, sections[13]->count - 1)) return false;
+	bvh.bottom.resize(sections[13]->count - 1);
+	for (uint64_t i = 0; i < bvh.bottom.size(); i++) {
+		copy_bvh(bvh_trees[i + 1], bvh.bottom[i]);
+		const SceneCacheMesh& mesh = i < sections[3]->count ? meshes[i] : meshes_with_normal_map[i - sections[3]->count];
+		if (!valid_bvh(bvh.bottom[i], mesh.index_count / 3)) return false;
+	}
+
+	// copy the geometry
+	scene->vertices.resize(num_vertices);
+	scene->vertices_with_tangent.resize(num_vertices_with_tangent);
+	scene->indices.resize(num_indices);
+	std::vector<CopyPiece> pieces;
+	auto add_pieces = [&](void* destination, const SceneCacheSection& section) {
+		if (is_encoded(section)) return;
+		for (uint64_t offset = 0; offset < section.size; offset += COPY_PIECE_SIZE) {
+			pieces.push_back({
+				static_cast<char*>(destination) + offset,
+				file.data + section.offset + offset,
+				std::min(COPY_PIECE_SIZE, section.size - offset)
+			});
+		}
+	};
+	add_pieces(scene->vertices.data(), vertices);
+	add_pieces(scene->vertices_with_tangent.data(), vertices_with_tangent);
+	add_pieces(scene->indices.data(), indices);
+	parallel_for(pieces.size(), [&](int i) {
+		memcpy(pieces[i].destination, pieces[i].source, pieces[i].size);
+	});
+	bool decoded = true;
+	if (is_encoded(vertices)) {
+		decoded = decoded && decode_vertices(file.data + vertices.offset, vertices.size, scene->vertices.data());
+	}
+	if (is_encoded(vertices_with_tangent)) {
+		decoded = decoded && decode_vertices(
+			file.data + vertices_with_tangent.offset, vertices_with_tangent.size, scene->vertices_with_tangent.data()
+		);
+	}
+	if (is_encoded(indices)) {
+		decoded = decoded && decode_indices(file.data + indices.offset, indices.size, scene->indices.data());
+	}
+
+	// the indices of every mesh stay within its vertices, on all the cores
+	uint64_t mesh_count = sections[3]->count + sections[4]->count;
+	std::vector<uint8_t> valid_meshes(mesh_count, 0);
+	if (decoded) {
+		parallel_for(mesh_count, [&](int i) {
+			const SceneCacheMesh& mesh = i < sections[3]->count ? meshes[i] : meshes_with_normal_map[i - sections[3]->count];
+			valid_meshes[i] = valid_indices(mesh, scene->indices.data());
+		});
+	}
+	for (uint8_t valid : valid_meshes) decoded = decoded && valid;
+	if (!decoded) {
+		scene->vertices.clear();
+		scene->vertices_with_tangent.clear();
+		scene->indices.clear();
+		return false;
+	}
+
+	// copy the meshes and the names
+	scene->meshes.resize(sections[3]->count);
+	for (uint64_t i = 0; i < sections[3]->count; i++) {
+		from_cache_mesh(meshes[i], strings, scene->meshes[i]);
+	}
+	scene->meshes_with_normal_map.resize(sections[4]->count);
+	for (uint64_t i = 0; i < sections[4]->count; i++) {
+		from_cache_mesh(meshes_with_normal_map[i], strings, scene->meshes_with_normal_map[i]);
+		scene->meshes_with_normal_map[i].normal_map_index = meshes_with_normal_map[i].normal_map_index;
+	}
+	scene->textures.resize(sections[5]->count);
+	for (uint64_t i = 0; i < sections[5]->count; i++) {
+		scene->textures[i].file_path.assign(strings + textures[i].offset, textures[i].size);
+	}
+	scene->normal_maps.resize(sections[6]->count);
+	for (uint64_t i = 0; i < sections[6]->count; i++) {
+		scene->normal_maps[i].file_path.assign(strings + normal_maps[i].offset, normal_maps[i].size);
+	}
+	scene->debug_node_names.resize(sections[7]->count);
+	for (uint64_t i = 0; i < sections[7]->count; i++) {
+		scene->debug_node_names[i].assign(strings + debug_node_names[i].offset, debug_node_names[i].size);
+	}
+
+	// the bvh, with the transforms its rays are moved with
+	scene->bvh = std::move(bvh);
+	set_bvh_transforms(scene);
+
+	// copy what the cache was built from
+	info.loader_version = header.loader_version;
+	info.sources.resize(sections[9]->count);
+	for (uint64_t i = 0; i < sections[9]->count; i++) {
+		info.sources[i].path.assign(strings + sources[i].path.offset, sources[i].path.size);
+		info.sources[i].size = sources[i].size;
+		info.sources[i].modified_time = sources[i].modified_time;
+		info.sources[i].hash = sources[i].hash;
+	}
+	info.mesh_signatures.assign(mesh_signatures, mesh_signatures + sections[10]->count);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "staging_ring.h"
+
+StagingRing::StagingRing(GPU* gpu_, VkDeviceSize size) {
+	/*
+	One buffer for the whole ring, every region has its own command buffer
+	and a fence that tells when the GPU is done with it
+	*/
+	gpu = gpu_;
+	region_size = size / STAGING_RING_REGIONS;
+	bytes_uploaded = 0;
+	num_submits = 0;
+	current = 0;
+
+	buffer = new Buffer(gpu, region_size * STAGING_RING_REGIONS, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	void* data;
+	vkMapMemory(gpu->logical_gpu, buffer->memory, 0, region_size * STAGING_RING_REGIONS, 0, &data);
+	mapped = static_cast<char*>(data);
+
+	regions.resize(STAGING_RING_REGIONS);
+	for (Region& region : regions) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = gpu->commandPool;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(gpu->logical_gpu, &allocInfo, &region.command_buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate staging ring command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(gpu->logical_gpu, &fenceInfo, nullptr, &region.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create staging ring fence!");
+		}
+
+		region.used = 0;
+		region.recording = false;
+		region.in_flight = false;
+	}
+}
+
+StagingRing::~StagingRing() {
+	for (Region& region : regions) {
+		if (region.recording) vkEndCommandBuffer(region.command_buffer);
+		wait(region);
+		vkDestroyFence(gpu->logical_gpu, region.fence, nullptr);
+		vkFreeCommandBuffers(gpu->logical_gpu, gpu->commandPool, 1, &region.command_buffer);
+	}
+	vkUnmapMemory(gpu->logical_gpu, buffer->memory);
+	delete buffer;
+}
+
+VkCommandBuffer StagingRing::commandBuffer() {
+	Region& region = regions[current];
+	if (!region.recording) {
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(region.command_buffer, &beginInfo);
+		region.recording = true;
+	}
+	return region.command_buffer;
+}
+
+bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, StagingSpan& span) {
+	if (size > region_size) throw std::runtime_error("failed to allocate staging memory, larger than a region");
+	Region& region = regions[current];
+	VkDeviceSize offset = (region.used + alignment - 1) / alignment * alignment;
+	if (offset + size > region_size) return false;
+	region.used = offset + size;
+	span.offset = current * region_size + offset;
+	span.data = mapped + span.offset;
+	bytes_uploaded += size;
+	return true;
+}
+
+void StagingRing::submit() {
+	Region& region = regions[current];
+	if (!region.recording && region.used == 0) return;
+
+	// the memory is coherent, so everything written before the submit is
+	// seen by the copies
+	if (region.recording) {
+		vkEndCommandBuffer(region.command_buffer);
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &region.command_buffer;
+		if (vkQueueSubmit(gpu->graphicsQueue, 1, &submitInfo, region.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit staging ring commands!");
+		}
+		region.recording = false;
+		region.in_flight = true;
+		num_submits++;
+	}
+
+	current = (current + 1) % STAGING_RING_REGIONS;
+	wait(regions[current]);
+	regions[current].used = 0;
+}
+
+void StagingRing::flush() {
+	submit();
+	for (Region& region : regions) wait(region);
+}
+
+void StagingRing::uploadBuffer(const void* data, VkDeviceSize size, VkBuffer destination, VkDeviceSize destination_offset) {
+	const char* source = static_cast<const char*>(data);
+	VkDeviceSize done = 0;
+	while (done < size) {
+		VkDeviceSize piece = std::min(size - done, region_size);
+		StagingSpan span;
+		if (!allocate(piece, 16, span)) {
+			submit();
+			allocate(piece, 16, span);
+		}
+		memcpy(span.data, source + done, piece);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = span.offset;
+		copyRegion.dstOffset = destination_offset + done;
+		copyRegion.size = piece;
+		vkCmdCopyBuffer(commandBuffer(), buffer->buffer, destination, 1, &copyRegion);
+		done += piece;
+	}
+}
+
+void StagingRing::wait(Region& region) {
+	if (!region.in_flight) return;
+	vkWaitForFences(gpu->logical_gpu, 1, &region.fence, VK_TRUE, UINT64_MAX);
+	vkResetFences(gpu->logical_gpu, 1, &region.fence);
+	region.in_flight = false;
+}
\ No newline at end of file
@@ -1,3 +1,13 @@
+#include <charconv>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SM_USE_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 #include "string_utils.h"
 
 std::vector<std::string> split(std::string s, char delimiter) {
@@ -12,4 +22,75 @@ std::vector<std::string> split(std::string s, char delimiter) {
 	}
 	splits.push_back(substring);
 	return splits;
+}
+
+#ifdef SM_USE_SSE2
+static int first_set_bit(unsigned int mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+size_t find_char(std::string_view s, char c) {
+	/*
+	Compare 16 characters at a time and fall back to a plain loop for the tail
+	*/
+
+	size_t i = 0;
+#ifdef SM_USE_SSE2
+	__m128i pattern = _mm_set1_epi8(c);
+	for (; i + 16 <= s.size(); i += 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data() + i));
+		unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+		if (mask != 0) return i + first_set_bit(mask);
+	}
+#endif
+	for (; i < s.size(); i++) {
+		if (s[i] == c) return i;
+	}
+	return s.size();
+}
+
+std::string_view next_token(std::string_view& s, char delimiter) {
+	size_t end = find_char(s, delimiter);
+	std::string_view token = s.substr(0, end);
+	s.remove_prefix(end < s.size() ? end + 1 : end);
+	return token;
+}
+
+std::string_view next_line(std::string_view& s) {
+	std::string_view line = next_token(s, '\n');
+	if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+	return line;
+}
+
+char char_at(std::string_view s, size_t i) {
+	return i < s.size() ? s[i] : '\0';
+}
+
+static std::string_view skip_space_and_plus(std::string_view s) {
+	/*
+	std::from_chars doesn't accept leading white spaces or a plus sign
+	*/
+	size_t i = 0;
+	while (i < s.size() && (s[i] == ' ' || (s[i] >= '\t' && s[i] <= '\r'))) i++;
+	if (i + 1 < s.size() && s[i] == '+' && s[i + 1] != '-') i++;
+	return s.substr(i);
+}
+
+bool parse_float(std::string_view s, float& value) {
+	s = skip_space_and_plus(s);
+	std::from_chars_result result = std::from_chars(s.data(), s.data() + s.size(), value);
+	return result.ec == std::errc();
+}
+
+bool parse_int(std::string_view s, int& value) {
+	s = skip_space_and_plus(s);
+	std::from_chars_result result = std::from_chars(s.data(), s.data() + s.size(), value);
+	return result.ec == std::errc();
 }
\ No newline at end of file
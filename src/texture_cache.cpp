@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "hash.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "texture_cache.h"
+#include "timer.h"
+
+static const char COOKED_TEXTURE_MAGIC[8] = { 'S', 'M', 'T', 'E', 'X', 'T', 'R', '\0' };
+
+static uint64_t align_up(uint64_t offset) {
+	return (offset + COOKED_TEXTURE_ALIGNMENT - 1) / COOKED_TEXTURE_ALIGNMENT * COOKED_TEXTURE_ALIGNMENT;
+}
+
+static uint64_t cook_key(const ImageSlot& slot, int num_channels, bool srgb) {
+	/*
+	The contents of the source image and everything that changes the cooked
+	bytes
+	*/
+	MappedFile file(slot.file_path);
+	uint64_t key = hash_bytes(file.data, file.size);
+	key = hash_combine(key, TEXTURE_CACHE_VERSION);
+	key = hash_combine(key, num_channels);
+	key = hash_combine(key, slot.encoding);
+	key = hash_combine(key, slot.level_offsets.size());
+	key = hash_combine(key, srgb);
+	return key;
+}
+
+static std::string cooked_path(std::string cache_directory, uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)key);
+	return (std::filesystem::path(cache_directory) / name).string();
+}
+
+static uint64_t level_space(const ImageSlot& slot, size_t level) {
+	/*
+	Bytes from the start of a level to the next level or the end of the slot
+	*/
+	uint64_t end = level + 1 < slot.level_offsets.size() ? slot.level_offsets[level + 1] : slot.offset + slot.size;
+	return end - slot.level_offsets[level];
+}
+
+static bool valid_format(ImageEncoding encoding, uint32_t format) {
+	switch (encoding) {
+	case ENCODING_COLOR_BC: return format == BLOCK_BC1 || format == BLOCK_BC3;
+	case ENCODING_NORMAL_BC: return format == BLOCK_BC5;
+	default: return format == BLOCK_NONE;
+	}
+}
+
+static bool read_cooked_levels(
+	const MappedFile& file,
+	const ImageSlot& slot,
+	int num_channels,
+	CookedTextureHeader& header,
+	std::vector<CookedTextureLevel>& levels
+) {
+	/*
+	Read the header and the level table of a cooked texture, false if they
+	don't match the slot. The slot may only hold the levels from its first
+	level on.
+	*/
+	if (file.size < sizeof(CookedTextureHeader)) return false;
+	memcpy(&header, file.data, sizeof(header));
+	if (memcmp(header.magic, COOKED_TEXTURE_MAGIC, sizeof(header.magic)) != 0) return false;
+	if (header.version != TEXTURE_CACHE_VERSION) return false;
+	if (header.width <= 0 || header.height <= 0) return false;
+	if (std::max(header.width >> slot.first_level, 1) != slot.width) return false;
+	if (std::max(header.height >> slot.first_level, 1) != slot.height) return false;
+	if (header.num_channels != num_channels) return false;
+	if (header.level_count != slot.first_level + slot.level_offsets.size()) return false;
+	if (!valid_format(slot.encoding, header.format)) return false;
+	if (file.size < sizeof(header) + header.level_count * sizeof(CookedTextureLevel)) return false;
+
+	levels.resize(header.level_count);
+	memcpy(levels.data(), file.data + sizeof(header), levels.size() * sizeof(CookedTextureLevel));
+	int width = header.width;
+	int height = header.height;
+	for (size_t i = 0; i < levels.size(); i++) {
+		if (levels[i].size != level_size(width, height, num_channels, BlockFormat(header.format))) return false;
+		if (i >= slot.first_level && levels[i].size > level_space(slot, i - slot.first_level)) return false;
+		if (levels[i].offset > file.size || levels[i].size > file.size - levels[i].offset) return false;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	return true;
+}
+
+static bool find_cooked_image(std::string path, uint64_t key, ImageSlot& slot, int num_channels) {
+	/*
+	Check that a cooked texture of the slot is in the cache and take its
+	block format
+	*/
+	std::error_code error;
+	if (!std::filesystem::exists(path, error)) return false;
+	MappedFile file(path);
+	CookedTextureHeader header;
+	std::vector<CookedTextureLevel> levels;
+	if (!read_cooked_levels(file, slot, num_channels, header, levels) || header.key != key) return false;
+	slot.format = BlockFormat(header.format);
+	return true;
+}
+
+static void write_cooked_image(std::string path, std::string temp_path, uint64_t key, const ImageSlot& slot,
+	int num_channels, const char* pixels) {
+	/*
+	Write the levels of a decoded slot, pixels is the slot itself. The file is
+	written under a temporary name and renamed, so an entry is never partly
+	written.
+	*/
+	CookedTextureHeader header;
+	memcpy(header.magic, COOKED_TEXTURE_MAGIC, sizeof(header.magic));
+	header.version = TEXTURE_CACHE_VERSION;
+	header.format = slot.format;
+	header.key = key;
+	header.width = slot.width;
+	header.height = slot.height;
+	header.num_channels = num_channels;
+	header.level_count = slot.level_offsets.size();
+
+	std::vector<CookedTextureLevel> levels(header.level_count);
+	uint64_t position = align_up(sizeof(header) + levels.size() * sizeof(CookedTextureLevel));
+	int width = slot.width;
+	int height = slot.height;
+	for (size_t i = 0; i < levels.size(); i++) {
+		levels[i].offset = position;
+		levels[i].size = level_size(width, height, num_channels, slot.format);
+		position = align_up(position + levels[i].size);
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+
+	try {
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) throw std::runtime_error("failed to open " + temp_path);
+		static const char padding[COOKED_TEXTURE_ALIGNMENT] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(CookedTextureLevel));
+		uint64_t written = sizeof(header) + levels.size() * sizeof(CookedTextureLevel);
+		for (size_t i = 0; i < levels.size(); i++) {
+			file.write(padding, levels[i].offset - written);
+			file.write(pixels + slot.level_offsets[i] - slot.offset, levels[i].size);
+			written = levels[i].offset + levels[i].size;
+		}
+		file.close();
+		if (file.fail()) throw std::runtime_error("failed to write " + temp_path);
+		std::filesystem::rename(temp_path, path);
+	} catch (...) {
+		std::error_code error;
+		std::filesystem::remove(temp_path, error);
+		throw;
+	}
+}
+
+int cook_images(std::vector<ImageSlot>& slots, int num_channels, bool srgb, std::string cache_directory) {
+	std::error_code error;
+	std::filesystem::create_directories(cache_directory, error);
+
+	std::atomic<int> num_cached(0);
+	parallel_for(slots.size(), [&](int i) {
+		Timer timer;
+		ImageSlot& slot = slots[i];
+		uint64_t key = cook_key(slot, num_channels, srgb);
+		std::string path = cooked_path(cache_directory, key);
+		if (find_cooked_image(path, key, slot, num_channels)) {
+			num_cached++;
+			slot.cooked_path = path;
+			slot.decode_time = timer.total();
+			return;
+		}
+
+		// decode into ordinary memory laid out like the slot
+		ImageSlot local_slot = slot;
+		local_slot.offset = 0;
+		for (uint64_t& offset : local_slot.level_offsets) offset -= slot.offset;
+		std::vector<char> pixels(slot.size);
+		decode_image(local_slot, num_channels, srgb, pixels.data());
+		slot.format = local_slot.format;
+
+		// the cache only makes the next start faster, so a failure is reported
+		// and the image is decoded again when it is read
+		try {
+			write_cooked_image(path, path + "." + std::to_string(i) + ".tmp", key, slot, num_channels, pixels.data());
+			slot.cooked_path = path;
+		} catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+		}
+		slot.decode_time = timer.total();
+	});
+	return num_cached;
+}
+
+static void decode_image_levels(const ImageSlot& slot, int num_channels, bool srgb, char* destination) {
+	/*
+	Decode the whole chain of an image in ordinary memory and copy the levels
+	that are in the slot
+	*/
+	uint64_t total_size;
+	ImageSlot whole_slot = plan_image_slots({ slot.file_path }, num_channels, slot.encoding, true, total_size)[0];
+	if (whole_slot.mip_levels != slot.first_level + slot.mip_levels) {
+		throw std::runtime_error("failed to load texture image " + slot.file_path + ", it changed while loading");
+	}
+	std::vector<char> pixels(whole_slot.size);
+	decode_image(whole_slot, num_channels, srgb, pixels.data());
+	if (whole_slot.format != slot.format) {
+		throw std::runtime_error("failed to load texture image " + slot.file_path + ", it changed while loading");
+	}
+	int width = slot.width;
+	int height = slot.height;
+	for (size_t i = 0; i < slot.level_offsets.size(); i++) {
+		memcpy(destination + slot.level_offsets[i] - slot.offset, pixels.data() + whole_slot.level_offsets[slot.first_level + i],
+			level_size(width, height, num_channels, slot.format));
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+}
+
+void read_image(ImageSlot& slot, int num_channels, bool srgb, char* destination) {
+	if (!slot.cooked_path.empty()) {
+		MappedFile file(slot.cooked_path);
+		CookedTextureHeader header;
+		std::vector<CookedTextureLevel> levels;
+		if (read_cooked_levels(file, slot, num_channels, header, levels) && header.format == slot.format) {
+			for (size_t i = 0; i < slot.level_offsets.size(); i++) {
+				const CookedTextureLevel& level = levels[slot.first_level + i];
+				memcpy(destination + slot.level_offsets[i] - slot.offset, file.data + level.offset, level.size);
+			}
+			return;
+		}
+	}
+
+	// not in the cache, or replaced since it was cooked
+	if (slot.first_level > 0) {
+		decode_image_levels(slot, num_channels, srgb, destination);
+		return;
+	}
+	ImageSlot local_slot = slot;
+	local_slot.offset = 0;
+	for (uint64_t& offset : local_slot.level_offsets) offset -= slot.offset;
+	decode_image(local_slot, num_channels, srgb, destination);
+	if (local_slot.format != slot.format) {
+		throw std::runtime_error("failed to load texture image " + slot.file_path + ", it changed while loading");
+	}
+}
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "texture_compression.h"
+
+static uint16_t to_rgb565(const float color[3]) {
+	int r = std::min(std::max(int(color[0] * (31.0f / 255.0f) + 0.5f), 0), 31);
+	int g = std::min(std::max(int(color[1] * (63.0f / 255.0f) + 0.5f), 0), 63);
+	int b = std::min(std::max(int(color[2] * (31.0f / 255.0f) + 0.5f), 0), 31);
+	return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static void from_rgb565(uint16_t color, int rgb[3]) {
+	int r = (color >> 11) & 31;
+	int g = (color >> 5) & 63;
+	int b = color & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void encode_color_block(const unsigned char* pixels, unsigned char* block) {
+	/*
+	A BC1 block of the 16 rgba pixels in 4-colour mode
+	*/
+
+	// the mean and the covariance of the colours
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) mean[c] += pixels[4 * i + c];
+	}
+	for (int c = 0; c < 3; c++) mean[c] /= 16.0f;
+	float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++) {
+		float r = pixels[4 * i] - mean[0];
+		float g = pixels[4 * i + 1] - mean[1];
+		float b = pixels[4 * i + 2] - mean[2];
+		covariance[0] += r * r;
+		covariance[1] += r * g;
+		covariance[2] += r * b;
+		covariance[3] += g * g;
+		covariance[4] += g * b;
+		covariance[5] += b * b;
+	}
+
+	// the principal axis by power iteration
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 4; iteration++) {
+		float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+		float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+		float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+		float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+		if (length < 1e-6f) break;
+		axis[0] = x / length;
+		axis[1] = y / length;
+		axis[2] = z / length;
+	}
+
+	// the extremes along the axis, pulled in a little to lower the error
+	float low = 1e30f;
+	float high = -1e30f;
+	for (int i = 0; i < 16; i++) {
+		float t = (pixels[4 * i] - mean[0]) * axis[0] + (pixels[4 * i + 1] - mean[1]) * axis[1] +
+			(pixels[4 * i + 2] - mean[2]) * axis[2];
+		low = std::min(low, t);
+		high = std::max(high, t);
+	}
+	float inset = (high - low) / 16.0f;
+	float axis_length_2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	float endpoints[2][3];
+	for (int c = 0; c < 3; c++) {
+		float scale = axis_length_2 > 0.0f ? axis[c] / axis_length_2 : 0.0f;
+		endpoints[0][c] = mean[c] + (high - inset) * scale;
+		endpoints[1][c] = mean[c] + (low + inset) * scale;
+	}
+	uint16_t color_0 = to_rgb565(endpoints[0]);
+	uint16_t color_1 = to_rgb565(endpoints[1]);
+
+	// 4-colour mode needs color_0 > color_1
+	uint32_t indices = 0;
+	if (color_0 < color_1) std::swap(color_0, color_1);
+	if (color_0 != color_1) {
+		int palette[4][3];
+		from_rgb565(color_0, palette[0]);
+		from_rgb565(color_1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			int best_distance = 1 << 30;
+			for (int k = 0; k < 4; k++) {
+				int distance = 0;
+				for (int c = 0; c < 3; c++) {
+					int d = pixels[4 * i + c] - palette[k][c];
+					distance += d * d;
+				}
+				if (distance < best_distance) {
+					best_distance = distance;
+					best = k;
+				}
+			}
+			indices |= uint32_t(best) << (2 * i);
+		}
+	}
+
+	memcpy(block, &color_0, 2);
+	memcpy(block + 2, &color_1, 2);
+	memcpy(block + 4, &indices, 4);
+}
+
+static void encode_channel_block(const unsigned char* pixels, int channel, unsigned char* block) {
+	/*
+	A BC4 block of one channel of the 16 rgba pixels in 8-value mode
+	*/
+	int high = 0;
+	int low = 255;
+	for (int i = 0; i < 16; i++) {
+		high = std::max(high, int(pixels[4 * i + channel]));
+		low = std::min(low, int(pixels[4 * i + channel]));
+	}
+
+	uint64_t indices = 0;
+	if (high != low) {
+		int palette[8] = { high, low };
+		for (int k = 1; k <= 6; k++) palette[k + 1] = ((7 - k) * high + k * low + 3) / 7;
+		for (int i = 0; i < 16; i++) {
+			int value = pixels[4 * i + channel];
+			int best = 0;
+			for (int k = 1; k < 8; k++) {
+				if (std::abs(value - palette[k]) < std::abs(value - palette[best])) best = k;
+			}
+			indices |= uint64_t(best) << (3 * i);
+		}
+	}
+
+	block[0] = (unsigned char)high;
+	block[1] = (unsigned char)low;
+	for (int b = 0; b < 6; b++) block[2 + b] = (unsigned char)(indices >> (8 * b));
+}
+
+uint32_t block_bytes(BlockFormat format) {
+	switch (format) {
+	case BLOCK_BC1: return 8;
+	case BLOCK_BC3: return 16;
+	case BLOCK_BC5: return 16;
+	default: return 0;
+	}
+}
+
+uint64_t compressed_size(int width, int height, BlockFormat format) {
+	return uint64_t((width + 3) / 4) * ((height + 3) / 4) * block_bytes(format);
+}
+
+bool is_opaque(const unsigned char* rgba, size_t num_pixels) {
+	for (size_t i = 0; i < num_pixels; i++) {
+		if (rgba[4 * i + 3] != 255) return false;
+	}
+	return true;
+}
+
+void compress_image(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* blocks) {
+	unsigned char pixels[64];
+	for (int block_y = 0; block_y < height; block_y += 4) {
+		for (int block_x = 0; block_x < width; block_x += 4) {
+
+			// gather the block, repeating the last row and column at the edges
+			for (int y = 0; y < 4; y++) {
+				int source_y = std::min(block_y + y, height - 1);
+				for (int x = 0; x < 4; x++) {
+					int source_x = std::min(block_x + x, width - 1);
+					memcpy(pixels + 4 * (4 * y + x), rgba + 4 * (size_t(source_y) * width + source_x), 4);
+				}
+			}
+
+			switch (format) {
+			case BLOCK_BC1:
+				encode_color_block(pixels, blocks);
+				break;
+			case BLOCK_BC3:
+				encode_channel_block(pixels, 3, blocks);
+				encode_color_block(pixels, blocks + 8);
+				break;
+			case BLOCK_BC5:
+				encode_channel_block(pixels, 0, blocks);
+				encode_channel_block(pixels, 1, blocks + 8);
+				break;
+			default:
+				break;
+			}
+			blocks += block_bytes(format);
+		}
+	}
+}
\ No newline at end of file
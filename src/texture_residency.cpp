@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cmath>
+
+#include "texture_residency.h"
+
+template <typename VertexType>
+static MeshFootprint footprint(const VertexType* vertices, int vertex_count, const uint32_t* indices, int index_count,
+	const glm::mat4& transform) {
+	/*
+	The sphere around the center of the bounding box, and the square root of
+	the uv area over the surface area of the triangles
+	*/
+	MeshFootprint result = { glm::vec3(0.0f), 0.0f, 0.0f };
+	if (vertex_count == 0) return result;
+
+	std::vector<glm::vec3> positions(vertex_count);
+	glm::vec3 low(INFINITY);
+	glm::vec3 high(-INFINITY);
+	for (int i = 0; i < vertex_count; i++) {
+		positions[i] = glm::vec3(transform * glm::vec4(vertices[i].pos, 1.0f));
+		low = glm::min(low, positions[i]);
+		high = glm::max(high, positions[i]);
+	}
+	result.center = (low + high) * 0.5f;
+	for (const glm::vec3& position : positions) {
+		result.radius = std::max(result.radius, glm::length(position - result.center));
+	}
+
+	double surface_area = 0.0;
+	double uv_area = 0.0;
+	for (int i = 0; i + 2 < index_count; i += 3) {
+		const glm::vec3& a = positions[indices[i]];
+		const glm::vec3& b = positions[indices[i + 1]];
+		const glm::vec3& c = positions[indices[i + 2]];
+		glm::vec2 uv_a = vertices[indices[i]].texCoord;
+		glm::vec2 uv_b = vertices[indices[i + 1]].texCoord;
+		glm::vec2 uv_c = vertices[indices[i + 2]].texCoord;
+		surface_area += 0.5 * glm::length(glm::cross(b - a, c - a));
+		uv_area += 0.5 * std::abs((uv_b.x - uv_a.x) * (uv_c.y - uv_a.y) - (uv_c.x - uv_a.x) * (uv_b.y - uv_a.y));
+	}
+	if (surface_area > 0.0) result.uv_density = static_cast<float>(std::sqrt(uv_area / surface_area));
+	return result;
+}
+
+MeshFootprint mesh_footprint(const Vertex* vertices, int vertex_count, const uint32_t* indices, int index_count,
+	const glm::mat4& transform) {
+	return footprint(vertices, vertex_count, indices, index_count, transform);
+}
+
+MeshFootprint mesh_footprint(const VertexWithTangent* vertices, int vertex_count, const uint32_t* indices, int index_count,
+	const glm::mat4& transform) {
+	return footprint(vertices, vertex_count, indices, index_count, transform);
+}
+
+TextureResidency::TextureResidency(uint64_t budget_, uint64_t upload_limit_) {
+	budget = budget_;
+	upload_limit = upload_limit_;
+	resident_bytes = 0;
+	whole_bytes = 0;
+	backlog_size = 0;
+	backlog_bytes = 0;
+	num_streamed_in = 0;
+	num_evicted = 0;
+	bytes_streamed = 0;
+	frame = 0;
+}
+
+int TextureResidency::add_image(const ImageSlot& slot, int num_channels) {
+	Image image;
+	image.chain_bytes.resize(slot.mip_levels + 1, 0);
+	image.floor = slot.mip_levels - 1;
+	int width = slot.width;
+	int height = slot.height;
+	for (uint32_t level = 0; level < slot.mip_levels; level++) {
+		image.chain_bytes[level] = level_size(width, height, num_channels, slot.format);
+		if (std::max(width, height) <= RESIDENCY_FLOOR_SIZE) image.floor = std::min(image.floor, level);
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	for (int level = slot.mip_levels - 2; level >= 0; level--) image.chain_bytes[level] += image.chain_bytes[level + 1];
+
+	// nothing is on the GPU until set_resident
+	image.resident = slot.mip_levels;
+	image.resident_size = 0;
+	image.wanted = image.floor;
+	image.last_used = 0;
+	whole_bytes += image.chain_bytes[0];
+	images.push_back(image);
+	return images.size() - 1;
+}
+
+uint32_t TextureResidency::floor_level(int image) const {
+	return images[image].floor;
+}
+
+uint32_t TextureResidency::resident_level(int image) const {
+	return images[image].resident;
+}
+
+void TextureResidency::begin_frame() {
+	frame++;
+	for (Image& image : images) image.wanted = image.floor;
+}
+
+void TextureResidency::request(int image, float texels_per_pixel) {
+	/*
+	Level n has 2^n times fewer texels per pixel, the finest level that still
+	has at least one texel per pixel is enough
+	*/
+	Image& requested = images[image];
+	uint32_t level = 0;
+	if (texels_per_pixel > 1.0f) level = static_cast<uint32_t>(std::floor(std::log2(texels_per_pixel)));
+	requested.wanted = std::min(requested.wanted, level);
+	requested.last_used = frame;
+}
+
+std::vector<ResidencyChange> TextureResidency::update() {
+
+	// the images that need finer levels, the ones missing the most first
+	std::vector<int> backlog;
+	std::vector<int> victims;
+	for (int i = 0; i < images.size(); i++) {
+		if (images[i].wanted < images[i].resident) backlog.push_back(i);
+		else if (images[i].wanted > images[i].resident) victims.push_back(i);
+	}
+	std::sort(backlog.begin(), backlog.end(), [&](int a, int b) {
+		uint32_t missing_a = images[a].resident - images[a].wanted;
+		uint32_t missing_b = images[b].resident - images[b].wanted;
+		if (missing_a != missing_b) return missing_a > missing_b;
+		return images[a].chain_bytes[images[a].wanted] < images[b].chain_bytes[images[b].wanted];
+	});
+
+	// the images that can give levels back, least recently used first
+	std::sort(victims.begin(), victims.end(), [&](int a, int b) {
+		if (images[a].last_used != images[b].last_used) return images[a].last_used < images[b].last_used;
+		return images[a].resident_size > images[b].resident_size;
+	});
+
+	std::vector<ResidencyChange> changes;
+	uint64_t projected_bytes = resident_bytes;
+	uint64_t uploaded = 0;
+	size_t next_victim = 0;
+	backlog_size = 0;
+	backlog_bytes = 0;
+	for (int index : backlog) {
+		Image& image = images[index];
+
+		// leave the rest for the next frames, but always stream one image
+		if (!changes.empty() && uploaded >= upload_limit) {
+			backlog_size++;
+			backlog_bytes += image.chain_bytes[image.wanted] - image.chain_bytes[image.resident];
+			continue;
+		}
+
+		// evict until the levels fit, or settle for coarser levels
+		auto fits = [&](uint32_t level) {
+			return projected_bytes - image.resident_size + image.chain_bytes[level] <= budget;
+		};
+		while (!fits(image.wanted) && next_victim < victims.size()) {
+			Image& victim = images[victims[next_victim]];
+			changes.push_back({ victims[next_victim], victim.wanted });
+			projected_bytes = projected_bytes - victim.resident_size + victim.chain_bytes[victim.wanted];
+			uploaded += victim.chain_bytes[victim.wanted];
+			num_evicted++;
+			next_victim++;
+		}
+		uint32_t level = image.wanted;
+		while (level < image.resident && !fits(level)) level++;
+		if (level < image.resident) {
+			changes.push_back({ index, level });
+			projected_bytes = projected_bytes - image.resident_size + image.chain_bytes[level];
+			uploaded += image.chain_bytes[level];
+			num_streamed_in++;
+		}
+		if (level > image.wanted) {
+			backlog_size++;
+			backlog_bytes += image.chain_bytes[image.wanted] - image.chain_bytes[level];
+		}
+	}
+	bytes_streamed += uploaded;
+	return changes;
+}
+
+void TextureResidency::set_resident(int image, uint32_t level, uint64_t size) {
+	Image& changed = images[image];
+	resident_bytes = resident_bytes - changed.resident_size + size;
+	changed.resident = level;
+	changed.resident_size = size;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#include "timer.h"
+
+Timer::Timer() {
+	start = std::chrono::steady_clock::now();
+	last = start;
+}
+
+double Timer::lap() {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double milliseconds = std::chrono::duration<double, std::milli>(now - last).count();
+	last = now;
+	return milliseconds;
+}
+
+double Timer::total() {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(now - start).count();
+}
\ No newline at end of file
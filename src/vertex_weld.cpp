@@ -0,0 +1,32 @@
+#include "vertex_weld.h"
+
+VertexWeldTable::VertexWeldTable(size_t max_vertices) {
+	/*
+	Keep the table at most 3/4 full so the probe sequences stay short
+	*/
+	size_t capacity = 16;
+	while (capacity < max_vertices + max_vertices / 3) capacity *= 2;
+	slots.assign(capacity, { 0, 0, -1 });
+	mask = capacity - 1;
+}
+
+int VertexWeldTable::find_or_insert(int pos_index, int uv_index, int nor_index, int new_index) {
+	uint64_t pos_uv = (uint64_t(uint32_t(pos_index)) << 32) | uint32_t(uv_index);
+
+	// mix the key bits so consecutive indices spread over the table
+	uint64_t hash = pos_uv ^ (uint64_t(uint32_t(nor_index)) * 0x9E3779B97F4A7C15ull);
+	hash ^= hash >> 29;
+	hash *= 0xBF58476D1CE4E5B9ull;
+	hash ^= hash >> 32;
+
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		Slot& slot = slots[i];
+		if (slot.vertex_index < 0) {
+			slot.pos_uv = pos_uv;
+			slot.nor = nor_index;
+			slot.vertex_index = new_index;
+			return -1;
+		}
+		if (slot.pos_uv == pos_uv && slot.nor == nor_index) return slot.vertex_index;
+	}
+}
\ No newline at end of file